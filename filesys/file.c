@@ -1,13 +1,20 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/pipe.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
-/* An open file. */
+/* An open file.  This is the "open file description" of POSIX:
+ * file descriptors created by dup2() or inherited across fork()
+ * point to the same struct file, and so share its position. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	int ref_cnt;                /* Number of references to this file. */
+	struct pipe *pipe;          /* Pipe, if this is one end of a pipe. */
+	bool pipe_writer;           /* Writing end of PIPE? */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -20,6 +27,8 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
+		file->pipe = NULL;
 		return file;
 	} else {
 		inode_close (inode);
@@ -28,6 +37,26 @@ file_open (struct inode *inode) {
 	}
 }
 
+/* Opens and returns one end of PIPE: the writing end if WRITER is
+ * true, the reading end otherwise.  Returns a null pointer if an
+ * allocation fails. */
+struct file *
+file_open_pipe (struct pipe *pipe, bool writer) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->ref_cnt = 1;
+		file->pipe = pipe;
+		file->pipe_writer = writer;
+	}
+	return file;
+}
+
+/* Returns true if FILE is one end of a pipe. */
+bool
+file_is_pipe (struct file *file) {
+	return file->pipe != NULL;
+}
+
 /* Opens and returns a new file for the same inode as FILE.
  * Returns a null pointer if unsuccessful. */
 struct file *
@@ -48,10 +77,38 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE and returns it.  The caller and the
+ * previous holders of FILE share its position and deny-write
+ * state; each reference must be released with file_close(). */
+struct file *
+file_dup (struct file *file) {
+	enum intr_level old_level;
+
+	ASSERT (file != NULL);
+	old_level = intr_disable ();
+	ASSERT (file->ref_cnt > 0);
+	file->ref_cnt++;
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Drops a reference to FILE, and closes it if that was the last
+ * one. */
 void
 file_close (struct file *file) {
 	if (file != NULL) {
+		enum intr_level old_level = intr_disable ();
+		ASSERT (file->ref_cnt > 0);
+		bool last = --file->ref_cnt == 0;
+		intr_set_level (old_level);
+		if (!last)
+			return;
+
+		if (file->pipe != NULL) {
+			pipe_close (file->pipe, file->pipe_writer);
+			free (file);
+			return;
+		}
 		file_allow_write (file);
 		inode_close (file->inode);
 		free (file);
@@ -71,6 +128,8 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? -1 : pipe_read (file->pipe, buffer, size);
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
@@ -95,6 +154,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? pipe_write (file->pipe, buffer, size) : -1;
 	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
@@ -140,6 +201,8 @@ file_allow_write (struct file *file) {
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->pipe != NULL)
+		return -1;
 	return inode_length (file->inode);
 }
 
@@ -0,0 +1,142 @@
+/* pipe.c: In-kernel pipes.
+ *
+ * A pipe is a PIPE_SIZE ring buffer with one reading and one writing
+ * end.  Each end is wrapped in a struct file (see file_open_pipe()),
+ * so pipes live in the file descriptor table like any other file and
+ * read(), write(), dup2() and close() work on them unchanged. */
+
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+struct pipe {
+	struct lock lock;           /* Protects all members below. */
+	struct condition not_empty; /* Signaled when data arrives. */
+	struct condition not_full;  /* Signaled when space frees up. */
+	uint8_t *buf;               /* PIPE_SIZE bytes of ring buffer. */
+	size_t head;                /* Index of the oldest byte. */
+	size_t used;                /* Number of bytes in the buffer. */
+	bool reader_open;           /* Is the reading end still open? */
+	bool writer_open;           /* Is the writing end still open? */
+};
+
+/* Creates and returns a new, empty pipe with both ends open.
+ * Returns a null pointer if memory allocation fails. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *pipe = malloc (sizeof *pipe);
+	if (pipe == NULL)
+		return NULL;
+
+	pipe->buf = palloc_get_page (0);
+	if (pipe->buf == NULL) {
+		free (pipe);
+		return NULL;
+	}
+	lock_init (&pipe->lock);
+	cond_init (&pipe->not_empty);
+	cond_init (&pipe->not_full);
+	pipe->head = 0;
+	pipe->used = 0;
+	pipe->reader_open = true;
+	pipe->writer_open = true;
+	return pipe;
+}
+
+/* Reads up to SIZE bytes from PIPE into BUFFER.  Blocks until at
+ * least one byte is available, then returns whatever is buffered.
+ * Returns 0 at end of file, that is, when the pipe is empty and its
+ * writing end has been closed. */
+off_t
+pipe_read (struct pipe *pipe, void *buffer_, off_t size) {
+	uint8_t *buffer = buffer_;
+	off_t bytes_read = 0;
+
+	if (size <= 0)
+		return 0;
+
+	lock_acquire (&pipe->lock);
+	while (pipe->used == 0 && pipe->writer_open)
+		cond_wait (&pipe->not_empty, &pipe->lock);
+
+	while (bytes_read < size && pipe->used > 0) {
+		/* Copy the contiguous run up to the end of the buffer. */
+		size_t chunk = PIPE_SIZE - pipe->head;
+		if (chunk > pipe->used)
+			chunk = pipe->used;
+		if (chunk > (size_t) (size - bytes_read))
+			chunk = size - bytes_read;
+
+		memcpy (buffer + bytes_read, pipe->buf + pipe->head, chunk);
+		pipe->head = (pipe->head + chunk) % PIPE_SIZE;
+		pipe->used -= chunk;
+		bytes_read += chunk;
+	}
+	cond_broadcast (&pipe->not_full, &pipe->lock);
+	lock_release (&pipe->lock);
+	return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into PIPE, blocking while the pipe
+ * is full.  Returns the number of bytes written, which is less than
+ * SIZE only if the reading end is closed meanwhile, or -1 if it was
+ * already closed. */
+off_t
+pipe_write (struct pipe *pipe, const void *buffer_, off_t size) {
+	const uint8_t *buffer = buffer_;
+	off_t bytes_written = 0;
+
+	lock_acquire (&pipe->lock);
+	if (!pipe->reader_open) {
+		lock_release (&pipe->lock);
+		return -1;
+	}
+	while (bytes_written < size && pipe->reader_open) {
+		size_t tail, chunk;
+
+		if (pipe->used == PIPE_SIZE) {
+			cond_wait (&pipe->not_full, &pipe->lock);
+			continue;
+		}
+
+		/* Copy the contiguous free run after the tail. */
+		tail = (pipe->head + pipe->used) % PIPE_SIZE;
+		chunk = tail >= pipe->head ? PIPE_SIZE - tail : pipe->head - tail;
+		if (chunk > (size_t) (size - bytes_written))
+			chunk = size - bytes_written;
+
+		memcpy (pipe->buf + tail, buffer + bytes_written, chunk);
+		pipe->used += chunk;
+		bytes_written += chunk;
+		cond_broadcast (&pipe->not_empty, &pipe->lock);
+	}
+	lock_release (&pipe->lock);
+	return bytes_written;
+}
+
+/* Closes the writing end of PIPE if WRITER is true, its reading end
+ * otherwise, and wakes up anyone blocked on the other end.  Frees
+ * PIPE once both ends are closed. */
+void
+pipe_close (struct pipe *pipe, bool writer) {
+	bool done;
+
+	lock_acquire (&pipe->lock);
+	if (writer)
+		pipe->writer_open = false;
+	else
+		pipe->reader_open = false;
+	cond_broadcast (&pipe->not_empty, &pipe->lock);
+	cond_broadcast (&pipe->not_full, &pipe->lock);
+	done = !pipe->reader_open && !pipe->writer_open;
+	lock_release (&pipe->lock);
+
+	if (done) {
+		palloc_free_page (pipe->buf);
+		free (pipe);
+	}
+}
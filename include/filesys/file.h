@@ -1,14 +1,19 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct pipe;
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_dup (struct file *file);
+struct file *file_open_pipe (struct pipe *, bool writer);
+bool file_is_pipe (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
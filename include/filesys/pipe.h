@@ -0,0 +1,18 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/vaddr.h"
+
+struct pipe;
+
+/* Capacity of a pipe's ring buffer, in bytes. */
+#define PIPE_SIZE PGSIZE
+
+struct pipe *pipe_create (void);
+off_t pipe_read (struct pipe *, void *, off_t size);
+off_t pipe_write (struct pipe *, const void *, off_t size);
+void pipe_close (struct pipe *, bool writer);
+
+#endif /* filesys/pipe.h */
@@ -96,6 +96,4 @@ bool hash_empty (struct hash *);
 uint64_t hash_bytes (const void *, size_t);
 uint64_t hash_string (const char *);
 uint64_t hash_int (int);
-unsigned page_hash(const struct hash_elem *p_, void *aux);
-bool spt_less_func (const struct hash_elem *a,const struct hash_elem *b,void *aux);
 #endif /* lib/kernel/hash.h */
@@ -0,0 +1,32 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ77 block compression, in the style of LZ4.
+ *
+ * A compressed block is a series of sequences.  Each sequence
+ * starts with a token byte whose high nibble is a literal count
+ * and whose low nibble is a match length minus LZ_MIN_MATCH; a
+ * nibble of 15 is continued by bytes that are added to it, up to
+ * and including the first byte that is not 255.  The literals
+ * follow, then a 2-byte little-endian offset back into the
+ * output for the match.  The last sequence stops after its
+ * literals.
+ *
+ * The compressor is a single greedy pass with a small hash table
+ * of earlier positions, which is fast and does well on the zeros
+ * and repeated structures that fill most pages.  Inputs are
+ * limited to 64 kB, so offsets always fit. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Shortest match worth encoding. */
+#define LZ_MIN_MATCH 4
+
+/* Longest input. */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *src, size_t src_len, void *dst, size_t dst_cap);
+bool lz_decompress (const void *src, size_t src_len, void *dst, size_t dst_len);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,76 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table keyed by 64-bit integers.
+ *
+ * Unlike struct hash, which chains struct hash_elem's through
+ * an array of lists, this table stores (key, value) pairs
+ * directly in one array and resolves collisions by linear
+ * probing.  A lookup usually touches a single cache line and
+ * never follows a pointer until the value itself.
+ *
+ * Values are plain pointers and must not be null; keys must be
+ * less than OHASH_KEY_MAX.  The table grows by doubling, but the
+ * elements are moved to the new array a few at a time by later
+ * insertions and deletions instead of all at once, so no single
+ * operation pays for a whole rehash.
+ *
+ * The API follows lib/kernel/hash.h: init/clear/destroy,
+ * insert/find/delete, apply and an iterator. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Keys at or above this value are reserved. */
+#define OHASH_KEY_MAX (UINT64_MAX - 1)
+
+/* One slot of the table. */
+struct ohash_slot {
+	uint64_t key;               /* Key, or an OHASH_* marker. */
+	void *value;                /* Value, if KEY is a real key. */
+};
+
+/* Performs some operation on VALUE, given auxiliary data AUX. */
+typedef void ohash_action_func (void *value, void *aux);
+
+/* Hash table. */
+struct ohash {
+	size_t elem_cnt;            /* Number of elements in table. */
+	struct ohash_slot *slots;   /* Current array, or null if empty. */
+	int bits;                   /* Current array has 2**BITS slots. */
+	struct ohash_slot *old;     /* Array being moved out of, or null. */
+	int old_bits;               /* Old array has 2**OLD_BITS slots. */
+	size_t old_cnt;             /* Elements still in the old array. */
+	size_t old_idx;             /* Next old slot to move. */
+	void *aux;                  /* Auxiliary data for actions. */
+};
+
+/* A hash table iterator. */
+struct ohash_iterator {
+	struct ohash *hash;         /* The hash table. */
+	struct ohash_slot *slot;    /* Current slot. */
+	bool in_old;                /* Iterating the old array? */
+};
+
+/* Basic life cycle. */
+void ohash_init (struct ohash *, void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+bool ohash_insert (struct ohash *, uint64_t key, void *value);
+void *ohash_find (struct ohash *, uint64_t key);
+void *ohash_delete (struct ohash *, uint64_t key);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+void *ohash_next (struct ohash_iterator *);
+void *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,63 @@
+#ifndef __LIB_KERNEL_RADIX_H
+#define __LIB_KERNEL_RADIX_H
+
+/* Radix tree keyed by page number.
+ *
+ * The tree has the same shape as an x86-64 page table: four
+ * levels of 512-entry nodes, each node one page, indexed by
+ * successive 9-bit slices of the key.  Keys therefore cover
+ * 36 bits, which is every page of a 48-bit address space.
+ *
+ * Neighbouring keys share their path from the root, so dense
+ * runs of pages (code, data, heap, stack) sit in a few leaves.
+ * Besides single-key insert/find/delete, the tree offers range
+ * operations whose cost grows with the number of keys in the
+ * range and skips empty subtrees, and iteration in key order.
+ *
+ * Values are plain pointers and must not be null. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bits of key consumed per level, and levels. */
+#define RADIX_BITS 9
+#define RADIX_LEVELS 4
+
+/* Keys must be less than this; lookups of larger keys find nothing
+   and insertions of them fail. */
+#define RADIX_KEY_LIMIT ((uint64_t) 1 << (RADIX_BITS * RADIX_LEVELS))
+
+/* Performs some operation on VALUE, given auxiliary data AUX. */
+typedef void radix_action_func (void *value, void *aux);
+
+/* Radix tree. */
+struct radix {
+	size_t elem_cnt;            /* Number of values in the tree. */
+	void **root;                /* Top-level node, or null if none. */
+	void *aux;                  /* Auxiliary data for actions. */
+};
+
+/* Basic life cycle. */
+void radix_init (struct radix *, void *aux);
+void radix_clear (struct radix *, radix_action_func *);
+
+/* Single keys. */
+bool radix_insert (struct radix *, uint64_t key, void *value);
+void *radix_find (struct radix *, uint64_t key);
+void *radix_delete (struct radix *, uint64_t key);
+
+/* Ranges of CNT keys starting at FIRST. */
+bool radix_reserve (struct radix *, uint64_t first, uint64_t cnt);
+bool radix_range_empty (struct radix *, uint64_t first, uint64_t cnt);
+void radix_apply_range (struct radix *, uint64_t first, uint64_t cnt,
+		radix_action_func *);
+size_t radix_delete_range (struct radix *, uint64_t first, uint64_t cnt,
+		radix_action_func *);
+
+/* Whole tree. */
+void radix_apply (struct radix *, radix_action_func *);
+size_t radix_size (struct radix *);
+bool radix_empty (struct radix *);
+
+#endif /* lib/kernel/radix.h */
@@ -36,6 +36,29 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra: IPC */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_SPAWN,                  /* Start a new process without fork. */
+
+	/* Extra: memory-mapped files */
+	SYS_MSYNC,                  /* Write back a mapped range. */
+	SYS_MADVISE,                /* Give a hint about a mapped range. */
+
+	/* Extra: resident set */
+	SYS_SET_RSS_LIMIT,          /* Limit the frames a process holds. */
+	SYS_SET_STACK_LIMIT,        /* Limit the size of the stack. */
 };
 
+/* Flags for SYS_MSYNC. */
+#define MS_ASYNC 1                  /* Start write-back, don't wait. */
+#define MS_SYNC 4                   /* Write back before returning. */
+
+/* Advice for SYS_MADVISE. */
+#define MADV_NORMAL 0               /* No special treatment. */
+#define MADV_RANDOM 1               /* Expect random access: no read-ahead. */
+#define MADV_SEQUENTIAL 2           /* Expect sequential access: read ahead more. */
+#define MADV_WILLNEED 3             /* Will be accessed soon: load now. */
+#define MADV_DONTNEED 4             /* Won't be accessed soon: free frames now. */
+
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -37,10 +38,16 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int pipe (int fds[2]);
+pid_t spawn (const char *cmd_line);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length, int flags);
+int madvise (void *addr, size_t length, int advice);
+int set_rss_limit (int page_cnt);
+int set_stack_limit (int page_cnt);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
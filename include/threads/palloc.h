@@ -14,10 +14,24 @@ enum palloc_flags {
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Per-thread cache of free pages from one pool.  See palloc.c. */
+#define PALLOC_MAG_SIZE 8
+struct palloc_magazine {
+	size_t cnt;                         /* Number of cached pages. */
+	void *pages[PALLOC_MAG_SIZE];       /* Cached pages, used as a stack. */
+};
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_huge_page (enum palloc_flags);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void **pages, size_t page_cnt);
+void palloc_magazine_drain (struct palloc_magazine mags[2]);
+void palloc_zero_init (void);
+size_t palloc_user_page_cnt (void);
+size_t palloc_user_free_cnt (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,25 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Maximum number of object caches.  Each thread keeps one free
+   list per cache, so this also sizes struct thread. */
+#define KMEM_CACHE_MAX 8
+
+/* Free objects of one cache held by one thread.  See slab.c. */
+struct kmem_local {
+	void *head;                 /* Singly linked free objects. */
+	size_t cnt;                 /* Number of objects on the list. */
+};
+
+struct kmem_cache;
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		void (*ctor) (void *));
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_thread_drain (void);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -5,6 +5,8 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -97,6 +99,8 @@ struct thread {
 	struct list lock_list;
 	struct file **files;
 	int fd_idx;
+	struct palloc_magazine page_mag[2]; /* Free page caches: kernel, user. */
+	struct kmem_local kmem_local[KMEM_CACHE_MAX]; /* Free objects per cache. */
 	int nice;
 	int32_t recent_cpu;
 	struct file *exec_file;
@@ -113,8 +117,16 @@ struct thread {
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
-	struct hash spt;
+	struct supplemental_page_table spt;
 	void *stack_bottom;
+	struct list frames;                 /* Frames charged to this process. */
+	size_t rss;                         /* Number of FRAMES. */
+	size_t rss_limit;                   /* Most frames before local replacement, 0 for none. */
+	size_t wss;                         /* Frames accessed in the last sample. */
+	int64_t wss_tick;                   /* When WSS was sampled. */
+	size_t stack_limit;                 /* Largest stack, in pages. */
+	int evict_cnt;                      /* Frames of ours being evicted. */
+	bool vm_exiting;                    /* Tearing down, frames not evictable. */
 #endif
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
@@ -134,6 +146,10 @@ void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 int thread_create (const char *name, int priority, thread_func *, void *);
+
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func (struct thread *t, void *aux);
+void thread_foreach (thread_action_func *, void *);
 int thread_ready_list(void);
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -31,6 +31,15 @@
 /* Round down to nearest page boundary. */
 #define pg_round_down(va) (void *) ((uint64_t) (va) & ~PGMASK)
 
+/* Huge page (2 MB), mapped by a single page directory entry. */
+#define HPGBITS 21                         /* Number of offset bits. */
+#define HPGSIZE (1 << HPGBITS)             /* Bytes in a huge page. */
+#define HPGMASK BITMASK(PGSHIFT, HPGBITS)  /* Huge page offset bits (0:21). */
+#define HPG_PAGES (HPGSIZE / PGSIZE)       /* Pages in a huge page. */
+
+/* Round down to nearest huge page boundary. */
+#define hpg_round_down(va) (void *) ((uint64_t) (va) & ~HPGMASK)
+
 /* Kernel virtual address start */
 #define KERN_BASE LOADER_KERN_BASE
 
@@ -3,12 +3,18 @@
 
 #include "threads/thread.h"
 
+struct page;
+
 int process_create_initd (const char *file_name);
+char *process_copy_cmdline (const char *cmd_line);
+void process_free_cmdline (char *cmd_line);
 int process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+int process_spawn (const char *cmd_line);
 int process_wait (int);
 void process_exit (void);
 void process_activate (struct thread *next);
 bool
 lazy_load_segment (struct page *page, void *aux);
+void lazy_load_run (struct page *first, size_t cnt);
 #endif /* userprog/process.h */
@@ -26,9 +26,15 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int pipe (int *fds);
+pid_t spawn (const char *cmd_line);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, unsigned int offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length, int flags);
+int madvise (void *addr, size_t length, int advice);
+int set_rss_limit (int page_cnt);
+int set_stack_limit (int page_cnt);
 
 #endif /* userprog/syscall.h */
@@ -8,6 +8,8 @@ enum vm_type;
 struct anon_page {
     enum vm_type type;
     int swap_idx;
+    int zswap_idx;      /* Entry in the compressed swap pool, or -1. */
+    bool zero;          /* Mapped read-only to the shared zero frame. */
 };
 
 void vm_anon_init (void);
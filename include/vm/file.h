@@ -11,6 +11,16 @@ struct file_page {
 	struct file *file;
 	int length;
 	int offset;
+	size_t bytes;           /* Bytes of the file in this page. */
+};
+
+/* Run of contiguous dirty pages being collected for one write. */
+struct file_writeback {
+	struct file *file;      /* File of the run, or NULL if empty. */
+	uint8_t *va;            /* User address of the run. */
+	off_t offset;           /* File offset of VA. */
+	size_t bytes;           /* Bytes in the run. */
+	size_t page_cnt;        /* Pages in the run. */
 };
 
 void vm_file_init (void);
@@ -18,4 +28,8 @@ bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+int do_msync (void *addr, size_t length, int flags);
+int do_madvise (void *addr, size_t length, int advice);
+void file_writeback_add (void *page, void *wb);
+void file_writeback_flush (struct file_writeback *wb);
 #endif
@@ -0,0 +1,9 @@
+#ifndef VM_HUGE_H
+#define VM_HUGE_H
+#include "vm/vm.h"
+
+struct page;
+
+bool vm_huge_claim (struct page *page, bool *success);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+
+void vm_kswapd_init (void);
+void vm_kswapd_poke (void);
+
+#endif
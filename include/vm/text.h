@@ -0,0 +1,13 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+#include "vm/vm.h"
+
+struct page;
+struct text_entry;
+
+void vm_text_init (void);
+bool vm_text_claim (struct page *page);
+bool vm_text_fork (struct page *src);
+void vm_text_release (struct page *page);
+
+#endif
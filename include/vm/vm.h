@@ -1,9 +1,27 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <syscall-nr.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "kernel/hash.h"
+#include "kernel/ohash.h"
+#include "kernel/radix.h"
 #include "threads/vaddr.h"
+
+/* Representation of current process's memory space.
+ * We don't want to force you to obey any specific design for this struct.
+ * All designs up to you for this. */
+// 가상 페이지 번호로 찾는 radix tree (page table과 같은 4단계 구조)
+// SPT_HASH를 정의하면 open-addressing hash를 사용
+struct supplemental_page_table {
+#ifdef SPT_HASH
+	struct ohash pages;
+#else
+	struct radix pages;
+#endif
+};
+
 #include "userprog/process.h"
 #include "lib/round.h"
 enum vm_type {
@@ -22,6 +40,8 @@ enum vm_type {
 	 * markers, until the value is fit in the int. */
 	IS_STACK = (1 << 3),
 	IS_WRITABLE = (1 << 4),
+	/* Read-only executable page whose frame is shared through vm/text.c. */
+	IS_SHARED = (1 << 5),
 
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
@@ -40,6 +60,7 @@ struct thread;
 // #define IS_STACK(type) (((type) & ~7) & 8)
 #define IS_WRITABLE(type) ((type) & IS_WRITABLE)
 #define IS_STACK(type) ((type) & IS_STACK)
+#define IS_SHARED(type) ((type) & IS_SHARED)
 #define VM_TYPE(type) ((type) & 7)
 
 /* The representation of "page".
@@ -52,7 +73,7 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
-	struct hash_elem hash_elem;
+	uint8_t advice;        /* MADV_* hint from madvise(). */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
@@ -75,8 +96,17 @@ struct frame {
 	void *kva;
 	struct page *page;
 	struct list_elem elem;
+	struct text_entry *text;   /* Shared text cache entry, or NULL. */
+	struct thread *owner;      /* Process charged for the frame. */
+	struct list_elem owner_elem; /* Element in OWNER's frames. */
+	bool evicting;             /* Being written out by another thread. */
 };
 
+/* Object caches for the structures above. */
+extern struct kmem_cache *page_slab;
+extern struct kmem_cache *frame_slab;
+extern struct kmem_cache *file_info_slab;
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -93,19 +123,21 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
-/* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
-
 #include "threads/thread.h"
-void supplemental_page_table_init (struct hash *spt);
-bool supplemental_page_table_copy (struct hash *dst,
-		struct hash *src);
-void supplemental_page_table_kill (struct hash *spt);
-struct page *spt_find_page (struct hash *spt,
+void supplemental_page_table_init (struct supplemental_page_table *spt);
+bool supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void supplemental_page_table_kill (struct supplemental_page_table *spt);
+struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
-bool spt_insert_page (struct hash *spt, struct page *page);
-void spt_remove_page (struct hash *spt, struct page *page);
+bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
+void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+bool spt_range_empty (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt);
+bool spt_reserve_range (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt);
+void spt_remove_range (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt);
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -117,6 +149,21 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+void vm_prefetch (void *va, size_t page_cnt);
+void vm_reclaim_page (struct page *page);
+bool vm_reclaim_frame (void);
+void vm_zero_unshare (const void *va, size_t size);
+struct frame *vm_get_frame (void);
+void vm_frame_track (struct frame *frame);
+void vm_frame_untrack (struct frame *frame);
+struct frame *vm_frame_claim (struct page *page);
+
+bool vm_stack_limit_valid (long page_cnt);
+
+/* Default frame limit of a new process, 0 for none. */
+extern size_t vm_rss_limit;
+/* Default stack limit of a new process, in pages. */
+extern size_t vm_stack_limit;
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,10 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+
+void vm_zswap_init (void);
+int vm_zswap_store (const void *kva);
+bool vm_zswap_load (int idx, void *kva);
+void vm_zswap_free (int idx);
+
+#endif
@@ -26,6 +26,7 @@ typedef unsigned long elem_type;
    simulates an array of bits. */
 struct bitmap {
 	size_t bit_cnt;     /* Number of bits. */
+	size_t cursor;      /* Where the last next-fit scan ended. */
 	elem_type *bits;    /* Elements that represent bits. */
 };
 
@@ -62,6 +63,43 @@ last_mask (const struct bitmap *b) {
 	int last_bits = b->bit_cnt % ELEM_BITS;
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns the number of bits set in WORD.  The kernel is not
+   linked with libgcc, so __builtin_popcountl() is not usable. */
+static inline size_t
+popcount (elem_type word) {
+	word = word - ((word >> 1) & 0x5555555555555555UL);
+	word = (word & 0x3333333333333333UL) + ((word >> 2) & 0x3333333333333333UL);
+	word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (word * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+
+   Works a whole element at a time: elements with no bit set to
+   VALUE are skipped with a single compare, and the first
+   matching bit within an element is found with bsf. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, size_t end, bool value) {
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t idx, last;
+	elem_type word;
+
+	if (start >= end)
+		return end;
+
+	idx = elem_idx (start);
+	last = elem_idx (end - 1);
+	word = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+	while (word == 0) {
+		if (++idx > last)
+			return end;
+		word = b->bits[idx] ^ flip;
+	}
+	start = idx * ELEM_BITS + __builtin_ctzl (word);
+	return start < end ? start : end;
+}
 
 /* Creation and destruction. */
 
@@ -74,6 +112,7 @@ bitmap_create (size_t bit_cnt) {
 	struct bitmap *b = malloc (sizeof *b);
 	if (b != NULL) {
 		b->bit_cnt = bit_cnt;
+		b->cursor = 0;
 		b->bits = malloc (byte_cnt (bit_cnt));
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
@@ -94,6 +133,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED) {
 	ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
 	b->bit_cnt = bit_cnt;
+	b->cursor = 0;
 	b->bits = (elem_type *) (b + 1);
 	bitmap_set_all (b, false);
 	return b;
@@ -211,33 +251,39 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t i, end, value_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
+	/* Count set bits a whole element at a time, masking off the
+	   parts of the first and last elements outside the range. */
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
-	return value_cnt;
+	end = start + cnt;
+	for (i = start; i < end; ) {
+		size_t bits = ELEM_BITS - i % ELEM_BITS;
+		elem_type word = b->bits[elem_idx (i)] >> (i % ELEM_BITS);
+
+		if (bits > end - i) {
+			bits = end - i;
+			word &= ((elem_type) 1 << bits) - 1;
+		}
+		value_cnt += popcount (word);
+		i += bits;
+	}
+	return value ? value_cnt : cnt - value_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return next_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -272,12 +318,21 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
+		size_t i = next_bit (b, start, last + 1, value);
+
+		/* I is the start of a run of VALUE bits.  Look for the end
+		   of the run within the next CNT bits; if there is none the
+		   run is long enough, otherwise skip past it. */
+		while (i <= last) {
+			size_t end = next_bit (b, i, i + cnt, !value);
+			if (end == i + cnt)
 				return i;
+			i = next_bit (b, end, last + 1, value);
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -296,6 +351,24 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
 		bitmap_set_multiple (b, idx, cnt, !value);
 	return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but searches next-fit: from where
+   the last successful call on B left off to the end of B, then
+   from the start of B.  Spreads allocations over the whole
+   bitmap and avoids rescanning a densely used prefix. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value) {
+	size_t start = b->cursor <= b->bit_cnt ? b->cursor : 0;
+	size_t idx = bitmap_scan (b, start, cnt, value);
+
+	if (idx == BITMAP_ERROR && start > 0)
+		idx = bitmap_scan (b, 0, cnt, value);
+	if (idx != BITMAP_ERROR) {
+		bitmap_set_multiple (b, idx, cnt, !value);
+		b->cursor = idx + cnt;
+	}
+	return idx;
+}
 
 /* File input and output. */
 
@@ -8,7 +8,6 @@
 #include "hash.h"
 #include "../debug.h"
 #include "threads/malloc.h"
-#include "include/vm/vm.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
 	list_entry(LIST_ELEM, struct hash_elem, list_elem)
@@ -20,17 +19,6 @@ static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
 
-unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED) {
-    const struct page *p = hash_entry(p_, struct page, hash_elem);
-    return hash_bytes(&p->va, sizeof p->va);
-}
-bool spt_less_func (const struct hash_elem *a,const struct hash_elem *b,void *aux){
-	struct page *page_a = hash_entry(a,struct page,hash_elem);
-	struct page *page_b = hash_entry(b,struct page,hash_elem);
-
-	return page_a->va > page_b->va;
-}
-
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
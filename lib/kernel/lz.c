@@ -0,0 +1,180 @@
+/* LZ77 block compression.
+
+   See lz.h for the block format.
+
+   The compressor hashes the 4 bytes at each position into a
+   table of the last position that had the same hash, and checks
+   the bytes there for a match.  The table lives in static
+   storage, which keeps it off the small kernel stack, so
+   lz_compress() is not reentrant: its callers must not run it in
+   two threads at once. */
+
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Hash table size. */
+#define LZ_HASH_BITS 10
+
+/* Literal or match lengths at or above this continue past the
+   token. */
+#define LZ_NIBBLE_MAX 15
+
+static uint16_t table[1 << LZ_HASH_BITS];
+
+/* Returns the 4 bytes at P as one word. */
+static inline uint32_t
+read32 (const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/* Returns the hash table index for the 4 bytes in SEQ. */
+static inline size_t
+hash (uint32_t seq) {
+	return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Stores the part of a length past the token nibble, LEN, at OP,
+   not going past OEND.  Returns the byte after it, or a null
+   pointer if it does not fit. */
+static uint8_t *
+put_len (uint8_t *op, uint8_t *oend, size_t len) {
+	for (; len >= 255; len -= 255) {
+		if (op == oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if (op == oend)
+		return NULL;
+	*op++ = len;
+	return op;
+}
+
+/* Reads the part of a length past the token nibble from *IP, not
+   going past IEND, and adds it to *LEN.  Returns false if the
+   input ends first. */
+static bool
+get_len (const uint8_t **ip, const uint8_t *iend, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip == iend)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Stores a sequence of the LIT_LEN literals at LIT followed by a
+   match of MATCH_LEN bytes OFFSET bytes back, or no match if
+   MATCH_LEN is 0, at OP, not going past OEND.  Returns the byte
+   after it, or a null pointer if it does not fit. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *oend, const uint8_t *lit,
+		size_t lit_len, size_t offset, size_t match_len) {
+	uint8_t *token;
+
+	if (op == oend)
+		return NULL;
+	token = op++;
+	*token = (lit_len < LZ_NIBBLE_MAX ? lit_len : LZ_NIBBLE_MAX) << 4;
+	if (lit_len >= LZ_NIBBLE_MAX
+			&& (op = put_len (op, oend, lit_len - LZ_NIBBLE_MAX)) == NULL)
+		return NULL;
+	if ((size_t) (oend - op) < lit_len)
+		return NULL;
+	memcpy (op, lit, lit_len);
+	op += lit_len;
+	if (match_len == 0)
+		return op;
+
+	match_len -= LZ_MIN_MATCH;
+	*token |= match_len < LZ_NIBBLE_MAX ? match_len : LZ_NIBBLE_MAX;
+	if (oend - op < 2)
+		return NULL;
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	if (match_len >= LZ_NIBBLE_MAX)
+		op = put_len (op, oend, match_len - LZ_NIBBLE_MAX);
+	return op;
+}
+
+/* Compresses the SRC_LEN bytes at SRC into DST, which has room
+   for DST_CAP bytes.  Returns the compressed size, or 0 if it
+   would not fit in DST_CAP bytes.  Not reentrant. */
+size_t
+lz_compress (const void *src_, size_t src_len, void *dst_, size_t dst_cap) {
+	const uint8_t *src = src_;
+	const uint8_t *ip = src, *anchor = src, *end = src + src_len;
+	uint8_t *dst = dst_, *op = dst, *oend = dst + dst_cap;
+
+	ASSERT (src_len <= LZ_MAX_INPUT);
+
+	memset (table, 0, sizeof table);
+	while (end - ip >= LZ_MIN_MATCH) {
+		uint32_t seq = read32 (ip);
+		size_t h = hash (seq);
+		const uint8_t *ref = src + table[h];
+
+		table[h] = ip - src;
+		if (ref < ip && read32 (ref) == seq) {
+			const uint8_t *mp = ip + LZ_MIN_MATCH;
+			const uint8_t *rp = ref + LZ_MIN_MATCH;
+
+			while (mp < end && *mp == *rp)
+				mp++, rp++;
+			op = put_sequence (op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+			if (op == NULL)
+				return 0;
+			ip = anchor = mp;
+		} else
+			ip++;
+	}
+	op = put_sequence (op, oend, anchor, end - anchor, 0, 0);
+	return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC, made by lz_compress(),
+   into the DST_LEN bytes at DST.  Returns false if SRC is
+   malformed or does not decompress to exactly DST_LEN bytes. */
+bool
+lz_decompress (const void *src_, size_t src_len, void *dst_, size_t dst_len) {
+	const uint8_t *ip = src_, *iend = ip + src_len;
+	uint8_t *dst = dst_, *op = dst, *oend = dst + dst_len;
+
+	while (ip < iend) {
+		unsigned token = *ip++;
+		size_t len = token >> 4;
+		size_t offset;
+
+		/* Literals. */
+		if (len == LZ_NIBBLE_MAX && !get_len (&ip, iend, &len))
+			return false;
+		if ((size_t) (iend - ip) < len || (size_t) (oend - op) < len)
+			return false;
+		memcpy (op, ip, len);
+		op += len;
+		ip += len;
+		if (ip == iend)
+			break;
+
+		/* Match.  It may overlap its own output, so copy a byte at
+		   a time. */
+		if (iend - ip < 2)
+			return false;
+		offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		len = token & LZ_NIBBLE_MAX;
+		if (len == LZ_NIBBLE_MAX && !get_len (&ip, iend, &len))
+			return false;
+		len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - dst)
+				|| (size_t) (oend - op) < len)
+			return false;
+		for (; len > 0; len--, op++)
+			*op = op[-offset];
+	}
+	return op == oend;
+}
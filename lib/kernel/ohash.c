@@ -0,0 +1,348 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information.
+
+   The current array never holds deleted-slot markers: deletion
+   shifts later members of the probe sequence back into the hole
+   ("backward shift"), so a probe always stops at the first empty
+   slot.
+
+   Growing allocates an array twice as large and makes the old
+   one read-only.  Every insertion and deletion then moves the
+   next OHASH_MOVE_CNT old slots into the new array, leaving a
+   tombstone behind so that probes for keys still in the old
+   array keep working.  Lookups check the new array first and
+   the old one second.  The old array is freed once every slot
+   has been moved.  With a 3/4 load limit and doubling, the move
+   always finishes long before the new array needs to grow. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Slot markers. */
+#define OHASH_EMPTY UINT64_MAX          /* Never used. */
+#define OHASH_TOMB (UINT64_MAX - 1)     /* Moved out of an old array. */
+
+/* Bits in the first array allocated. */
+#define OHASH_MIN_BITS 4
+
+/* Old slots moved by each insertion or deletion. */
+#define OHASH_MOVE_CNT 8
+
+static struct ohash_slot *alloc_slots (int bits);
+static struct ohash_slot *probe (struct ohash_slot *, int bits, uint64_t key);
+static void place (struct ohash_slot *, int bits, uint64_t key, void *value);
+static void remove_slot (struct ohash_slot *, int bits, struct ohash_slot *);
+static void move_some (struct ohash *, size_t cnt);
+static bool grow (struct ohash *);
+
+/* Returns the slot index for KEY in an array of 2**BITS slots.
+   Fibonacci hashing: the multiply spreads consecutive page
+   numbers over the whole array. */
+static inline size_t
+slot_idx (uint64_t key, int bits) {
+	return (key * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+}
+
+/* Initializes hash table H, with auxiliary data AUX for actions.
+   No memory is allocated until the first insertion. */
+void
+ohash_init (struct ohash *h, void *aux) {
+	h->elem_cnt = 0;
+	h->slots = NULL;
+	h->bits = 0;
+	h->old = NULL;
+	h->old_bits = 0;
+	h->old_cnt = 0;
+	h->old_idx = 0;
+	h->aux = aux;
+}
+
+/* Removes all the elements from H and frees its arrays, leaving
+   H empty and ready for reuse.
+
+   If DESTRUCTOR is non-null, then it is called for each value in
+   the hash, given H's auxiliary data.  Modifying H while
+   ohash_clear() is running yields undefined behavior, whether
+   done in DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor) {
+	if (destructor != NULL)
+		ohash_apply (h, destructor);
+	free (h->slots);
+	free (h->old);
+	ohash_init (h, h->aux);
+}
+
+/* Destroys hash table H.  Same as ohash_clear(), since a cleared
+   table owns no memory. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor) {
+	ohash_clear (h, destructor);
+}
+
+/* Inserts VALUE into H under KEY.  Returns false without
+   changing H if KEY is already present or memory for a larger
+   array is not available. */
+bool
+ohash_insert (struct ohash *h, uint64_t key, void *value) {
+	ASSERT (key < OHASH_KEY_MAX);
+	ASSERT (value != NULL);
+
+	if (ohash_find (h, key) != NULL)
+		return false;
+
+	move_some (h, OHASH_MOVE_CNT);
+	if (h->slots == NULL
+			|| (h->elem_cnt - h->old_cnt + 1) * 4 > ((size_t) 3 << h->bits))
+		if (!grow (h))
+			return false;
+
+	place (h->slots, h->bits, key, value);
+	h->elem_cnt++;
+	return true;
+}
+
+/* Returns the value stored under KEY in H, or a null pointer if
+   there is none. */
+void *
+ohash_find (struct ohash *h, uint64_t key) {
+	struct ohash_slot *s;
+
+	if (h->slots == NULL)
+		return NULL;
+	s = probe (h->slots, h->bits, key);
+	if (s == NULL && h->old != NULL)
+		s = probe (h->old, h->old_bits, key);
+	return s != NULL ? s->value : NULL;
+}
+
+/* Removes KEY from H and returns the value stored under it, or a
+   null pointer if KEY was not present. */
+void *
+ohash_delete (struct ohash *h, uint64_t key) {
+	struct ohash_slot *s;
+	void *value;
+
+	if (h->slots == NULL)
+		return NULL;
+
+	if ((s = probe (h->slots, h->bits, key)) != NULL) {
+		value = s->value;
+		remove_slot (h->slots, h->bits, s);
+	} else if (h->old != NULL
+			&& (s = probe (h->old, h->old_bits, key)) != NULL) {
+		value = s->value;
+		s->key = OHASH_TOMB;
+		h->old_cnt--;
+	} else
+		return NULL;
+
+	h->elem_cnt--;
+	move_some (h, OHASH_MOVE_CNT);
+	return value;
+}
+
+/* Calls ACTION for each value in hash table H in arbitrary
+   order, given H's auxiliary data.  Modifying H while
+   ohash_apply() is running yields undefined behavior. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action) {
+	struct ohash_iterator i;
+	void *value;
+
+	ASSERT (action != NULL);
+
+	ohash_first (&i, h);
+	while ((value = ohash_next (&i)) != NULL)
+		action (value, h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+   struct ohash_iterator i;
+   struct foo *f;
+
+   ohash_first (&i, h);
+   while ((f = ohash_next (&i)) != NULL)
+   {
+   ...do something with f...
+   }
+
+   Modifying hash table H during iteration invalidates all
+   iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h) {
+	ASSERT (i != NULL);
+	ASSERT (h != NULL);
+
+	i->hash = h;
+	i->slot = NULL;
+	i->in_old = false;
+}
+
+/* Advances I to the next value in the hash table and returns
+   it.  Returns a null pointer when no values are left. */
+void *
+ohash_next (struct ohash_iterator *i) {
+	struct ohash *h = i->hash;
+
+	for (;;) {
+		struct ohash_slot *slots = i->in_old ? h->old : h->slots;
+		int bits = i->in_old ? h->old_bits : h->bits;
+
+		if (slots != NULL) {
+			struct ohash_slot *end = slots + ((size_t) 1 << bits);
+
+			i->slot = i->slot == NULL ? slots : i->slot + 1;
+			for (; i->slot < end; i->slot++)
+				if (i->slot->key < OHASH_KEY_MAX)
+					return i->slot->value;
+		}
+		if (i->in_old) {
+			i->slot = NULL;
+			return NULL;
+		}
+		i->in_old = true;
+		i->slot = NULL;
+	}
+}
+
+/* Returns the current value in the hash table iteration, or a
+   null pointer at the end of the table. */
+void *
+ohash_cur (struct ohash_iterator *i) {
+	return i->slot != NULL ? i->slot->value : NULL;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h) {
+	return h->elem_cnt == 0;
+}
+
+/* Allocates an array of 2**BITS empty slots.  Returns a null
+   pointer if memory is not available. */
+static struct ohash_slot *
+alloc_slots (int bits) {
+	size_t cnt = (size_t) 1 << bits;
+	struct ohash_slot *slots = malloc (cnt * sizeof *slots);
+	size_t i;
+
+	if (slots != NULL)
+		for (i = 0; i < cnt; i++)
+			slots[i].key = OHASH_EMPTY;
+	return slots;
+}
+
+/* Returns the slot holding KEY in SLOTS, an array of 2**BITS
+   slots, or a null pointer if KEY is not there. */
+static struct ohash_slot *
+probe (struct ohash_slot *slots, int bits, uint64_t key) {
+	size_t mask = ((size_t) 1 << bits) - 1;
+	size_t i;
+
+	for (i = slot_idx (key, bits); slots[i].key != OHASH_EMPTY; i = (i + 1) & mask)
+		if (slots[i].key == key)
+			return &slots[i];
+	return NULL;
+}
+
+/* Stores KEY and VALUE in the first empty slot of KEY's probe
+   sequence in SLOTS, which must have one. */
+static void
+place (struct ohash_slot *slots, int bits, uint64_t key, void *value) {
+	size_t mask = ((size_t) 1 << bits) - 1;
+	size_t i;
+
+	for (i = slot_idx (key, bits); slots[i].key != OHASH_EMPTY; i = (i + 1) & mask)
+		continue;
+	slots[i].key = key;
+	slots[i].value = value;
+}
+
+/* Empties slot S of SLOTS, an array of 2**BITS slots, shifting
+   later slots of the same cluster back so that no probe
+   sequence is broken. */
+static void
+remove_slot (struct ohash_slot *slots, int bits, struct ohash_slot *s) {
+	size_t mask = ((size_t) 1 << bits) - 1;
+	size_t hole = s - slots;
+	size_t i;
+
+	for (i = (hole + 1) & mask; slots[i].key != OHASH_EMPTY; i = (i + 1) & mask) {
+		size_t home = slot_idx (slots[i].key, bits);
+
+		/* Slot I may fill the hole if its home is not in the
+		   cyclic range (HOLE, I]. */
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			slots[hole] = slots[i];
+			hole = i;
+		}
+	}
+	slots[hole].key = OHASH_EMPTY;
+}
+
+/* Moves up to CNT slots of H's old array into the current one,
+   and frees the old array once all of it has been moved. */
+static void
+move_some (struct ohash *h, size_t cnt) {
+	size_t old_size;
+
+	if (h->old == NULL)
+		return;
+
+	old_size = (size_t) 1 << h->old_bits;
+	for (; cnt > 0 && h->old_idx < old_size; cnt--, h->old_idx++) {
+		struct ohash_slot *s = &h->old[h->old_idx];
+
+		if (s->key < OHASH_KEY_MAX) {
+			place (h->slots, h->bits, s->key, s->value);
+			s->key = OHASH_TOMB;
+			h->old_cnt--;
+		}
+	}
+	if (h->old_idx == old_size) {
+		ASSERT (h->old_cnt == 0);
+		free (h->old);
+		h->old = NULL;
+		h->old_bits = 0;
+		h->old_idx = 0;
+	}
+}
+
+/* Replaces H's current array by one twice as large and starts
+   moving the elements over.  Returns false if memory is not
+   available and H's current array has no room left. */
+static bool
+grow (struct ohash *h) {
+	int bits = h->slots != NULL ? h->bits + 1 : OHASH_MIN_BITS;
+	struct ohash_slot *slots;
+
+	/* Finish any earlier move first; there is room for only one
+	   old array. */
+	if (h->old != NULL)
+		move_some (h, (size_t) 1 << h->old_bits);
+
+	slots = alloc_slots (bits);
+	if (slots == NULL)
+		return h->slots != NULL && h->elem_cnt + 1 < ((size_t) 1 << h->bits);
+
+	h->old = h->slots;
+	h->old_bits = h->bits;
+	h->old_cnt = h->elem_cnt;
+	h->old_idx = 0;
+	h->slots = slots;
+	h->bits = bits;
+	move_some (h, OHASH_MOVE_CNT);
+	return true;
+}
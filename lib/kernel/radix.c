@@ -0,0 +1,270 @@
+/* Radix tree.
+
+   See radix.h for basic information.
+
+   Level 0 nodes hold values; higher levels hold pointers to the
+   nodes one level down.  A node is a page obtained from the page
+   allocator, so a full level matches one page of a hardware page
+   table.  Nodes are created on demand by insertions and
+   radix_reserve().  A single deletion never frees a node;
+   radix_delete_range() and radix_clear() free every node they
+   leave empty. */
+
+#include "radix.h"
+#include "../debug.h"
+#include "threads/palloc.h"
+
+/* Entries per node. */
+#define RADIX_FANOUT (1 << RADIX_BITS)
+
+/* What walk() does with each value in range. */
+enum walk_mode {
+	WALK_ANY,                   /* Stop at the first value. */
+	WALK_APPLY,                 /* Call the action. */
+	WALK_DELETE                 /* Remove, then call the action. */
+};
+
+static void **lookup (struct radix *, uint64_t key, bool create);
+static bool walk (struct radix *, void **node, int level, uint64_t base,
+		uint64_t first, uint64_t last, enum walk_mode,
+		radix_action_func *);
+static bool node_empty (void **node);
+static uint64_t clamp (uint64_t first, uint64_t cnt);
+
+/* Returns the index into a node at LEVEL for KEY. */
+static inline size_t
+level_idx (uint64_t key, int level) {
+	return (key >> (level * RADIX_BITS)) & (RADIX_FANOUT - 1);
+}
+
+/* Initializes tree R, with auxiliary data AUX for actions.  No
+   memory is allocated until the first insertion. */
+void
+radix_init (struct radix *r, void *aux) {
+	r->elem_cnt = 0;
+	r->root = NULL;
+	r->aux = aux;
+}
+
+/* Removes all the values from R and frees its nodes, leaving R
+   empty and ready for reuse.  If DESTRUCTOR is non-null, it is
+   called for each value in key order, after the value has been
+   removed, given R's auxiliary data. */
+void
+radix_clear (struct radix *r, radix_action_func *destructor) {
+	radix_delete_range (r, 0, RADIX_KEY_LIMIT, destructor);
+	if (r->root != NULL) {
+		palloc_free_page (r->root);
+		r->root = NULL;
+	}
+}
+
+/* Inserts VALUE into R under KEY.  Returns false without
+   changing R if KEY is already present or a node could not be
+   allocated. */
+bool
+radix_insert (struct radix *r, uint64_t key, void *value) {
+	void **slot;
+
+	ASSERT (value != NULL);
+
+	slot = lookup (r, key, true);
+	if (slot == NULL || *slot != NULL)
+		return false;
+	*slot = value;
+	r->elem_cnt++;
+	return true;
+}
+
+/* Returns the value stored under KEY in R, or a null pointer if
+   there is none. */
+void *
+radix_find (struct radix *r, uint64_t key) {
+	void **slot = lookup (r, key, false);
+	return slot != NULL ? *slot : NULL;
+}
+
+/* Removes KEY from R and returns the value stored under it, or a
+   null pointer if KEY was not present. */
+void *
+radix_delete (struct radix *r, uint64_t key) {
+	void **slot = lookup (r, key, false);
+	void *value;
+
+	if (slot == NULL || *slot == NULL)
+		return NULL;
+	value = *slot;
+	*slot = NULL;
+	r->elem_cnt--;
+	return value;
+}
+
+/* Creates every node needed to hold keys FIRST through
+   FIRST + CNT - 1, so that inserting them afterward only walks
+   existing nodes and cannot fail.  Returns false if a node could
+   not be allocated. */
+bool
+radix_reserve (struct radix *r, uint64_t first, uint64_t cnt) {
+	uint64_t key;
+
+	if (clamp (first, cnt) != cnt)
+		return false;
+
+	/* One lookup per leaf node covers the whole leaf. */
+	for (key = first; key < first + cnt; key = (key | (RADIX_FANOUT - 1)) + 1)
+		if (lookup (r, key, true) == NULL)
+			return false;
+	return true;
+}
+
+/* Returns true if no key from FIRST through FIRST + CNT - 1 is
+   in R. */
+bool
+radix_range_empty (struct radix *r, uint64_t first, uint64_t cnt) {
+	cnt = clamp (first, cnt);
+	if (r->root == NULL || cnt == 0)
+		return true;
+	return !walk (r, r->root, RADIX_LEVELS - 1, 0, first, first + cnt - 1,
+			WALK_ANY, NULL);
+}
+
+/* Calls ACTION, in key order and given R's auxiliary data, for
+   each value in R under a key from FIRST through
+   FIRST + CNT - 1.  Modifying R from ACTION yields undefined
+   behavior. */
+void
+radix_apply_range (struct radix *r, uint64_t first, uint64_t cnt,
+		radix_action_func *action) {
+	ASSERT (action != NULL);
+
+	cnt = clamp (first, cnt);
+	if (r->root != NULL && cnt > 0)
+		walk (r, r->root, RADIX_LEVELS - 1, 0, first, first + cnt - 1,
+				WALK_APPLY, action);
+}
+
+/* Removes every key from FIRST through FIRST + CNT - 1 from R
+   and frees the nodes this leaves empty.  If ACTION is non-null,
+   it is called on each removed value in key order, given R's
+   auxiliary data; it must not modify R.  Returns the number of
+   values removed. */
+size_t
+radix_delete_range (struct radix *r, uint64_t first, uint64_t cnt,
+		radix_action_func *action) {
+	size_t old_cnt = r->elem_cnt;
+
+	cnt = clamp (first, cnt);
+	if (r->root != NULL && cnt > 0)
+		walk (r, r->root, RADIX_LEVELS - 1, 0, first, first + cnt - 1,
+				WALK_DELETE, action);
+	return old_cnt - r->elem_cnt;
+}
+
+/* Calls ACTION for each value in R in key order, given R's
+   auxiliary data.  Modifying R from ACTION yields undefined
+   behavior. */
+void
+radix_apply (struct radix *r, radix_action_func *action) {
+	radix_apply_range (r, 0, RADIX_KEY_LIMIT, action);
+}
+
+/* Returns the number of values in R. */
+size_t
+radix_size (struct radix *r) {
+	return r->elem_cnt;
+}
+
+/* Returns true if R holds no values, false otherwise. */
+bool
+radix_empty (struct radix *r) {
+	return r->elem_cnt == 0;
+}
+
+/* Returns the level 0 slot for KEY in R.  If a node on the way
+   is missing, returns a null pointer, or if CREATE is true
+   allocates it, returning a null pointer only if that fails.
+   Also returns a null pointer if KEY is out of range. */
+static void **
+lookup (struct radix *r, uint64_t key, bool create) {
+	void ***link = &r->root;
+	int level;
+
+	if (key >= RADIX_KEY_LIMIT)
+		return NULL;
+
+	for (level = RADIX_LEVELS - 1; ; level--) {
+		void **node = *link;
+
+		if (node == NULL) {
+			if (!create || (node = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*link = node;
+		}
+		if (level == 0)
+			return &node[level_idx (key, 0)];
+		link = (void ***) &node[level_idx (key, level)];
+	}
+}
+
+/* Visits the values in NODE, a node at LEVEL whose first key is
+   BASE, with keys from FIRST through LAST, in key order, doing
+   what MODE says.  Returns true if a WALK_ANY walk found a
+   value. */
+static bool
+walk (struct radix *r, void **node, int level, uint64_t base,
+		uint64_t first, uint64_t last, enum walk_mode mode,
+		radix_action_func *action) {
+	uint64_t span = (uint64_t) 1 << (level * RADIX_BITS);
+	size_t lo = first > base ? (first - base) / span : 0;
+	size_t hi = (last - base) / span;
+	size_t i;
+
+	if (hi > RADIX_FANOUT - 1)
+		hi = RADIX_FANOUT - 1;
+
+	for (i = lo; i <= hi; i++) {
+		void *entry = node[i];
+
+		if (entry == NULL)
+			continue;
+		if (level > 0) {
+			if (walk (r, entry, level - 1, base + i * span, first, last,
+						mode, action))
+				return true;
+			if (mode == WALK_DELETE && node_empty (entry)) {
+				palloc_free_page (entry);
+				node[i] = NULL;
+			}
+		} else if (mode == WALK_ANY)
+			return true;
+		else {
+			if (mode == WALK_DELETE) {
+				node[i] = NULL;
+				r->elem_cnt--;
+			}
+			if (action != NULL)
+				action (entry, r->aux);
+		}
+	}
+	return false;
+}
+
+/* Returns true if every entry of NODE is null. */
+static bool
+node_empty (void **node) {
+	size_t i;
+
+	for (i = 0; i < RADIX_FANOUT; i++)
+		if (node[i] != NULL)
+			return false;
+	return true;
+}
+
+/* Returns how many of the CNT keys starting at FIRST are less
+   than RADIX_KEY_LIMIT. */
+static uint64_t
+clamp (uint64_t first, uint64_t cnt) {
+	if (first >= RADIX_KEY_LIMIT)
+		return 0;
+	return cnt < RADIX_KEY_LIMIT - first ? cnt : RADIX_KEY_LIMIT - first;
+}
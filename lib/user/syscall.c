@@ -145,6 +145,16 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+pid_t
+spawn (const char *cmd_line) {
+	return (pid_t) syscall1 (SYS_SPAWN, cmd_line);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -155,6 +165,26 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+set_rss_limit (int page_cnt) {
+	return syscall1 (SYS_SET_RSS_LIMIT, page_cnt);
+}
+
+int
+set_stack_limit (int page_cnt) {
+	return syscall1 (SYS_SET_STACK_LIMIT, page_cnt);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -0,0 +1,160 @@
+/* Huge page benchmark.
+
+   Maps the same physically contiguous, 2 MB aligned user memory
+   into a fresh page table twice, once with 4 kB PTEs and once with
+   one 2 MB page directory entry per 2 MB, and times loads that
+   touch one word per 4 kB page in a shuffled order.  Every load
+   in the 4 kB mapping needs its own TLB entry; in the 2 MB
+   mapping 512 pages share one, so the difference is the cost of
+   TLB misses.  Also checks that both mappings reach the same
+   bytes and that pml4_clear_page() on a 2 MB mapping unmaps just
+   one 4 kB page.
+
+   Not part of the graded test set; run it by hand with
+   `pintos -- -q run hugepage-bench'. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define ROUNDS 20
+#define MAX_HUGE 8
+
+/* User address the region is mapped at. */
+#define REGION ((uint8_t *) 0x10000000)
+
+static void *blocks[MAX_HUGE];
+static size_t *order;
+
+/* Switches to PML4, or back to the kernel's page table if PML4 is
+   null, in a way that survives a context switch. */
+static void
+use_pml4 (uint64_t *pml4)
+{
+#ifdef USERPROG
+  thread_current ()->pml4 = pml4;
+#endif
+  pml4_activate (pml4);
+}
+
+/* Touches each of the PAGE_CNT pages of REGION in shuffled order,
+   ROUNDS times, and returns the average cycles per load. */
+static uint64_t
+touch (size_t page_cnt)
+{
+  volatile uint64_t sum = 0;
+  uint64_t start;
+  size_t i;
+  int r;
+
+  start = rdtsc ();
+  for (r = 0; r < ROUNDS; r++)
+    for (i = 0; i < page_cnt; i++)
+      sum += *(uint64_t *) (REGION + order[i] * PGSIZE
+                            + (order[i] % 64) * 64);
+  return (rdtsc () - start) / (ROUNDS * page_cnt);
+}
+
+/* Maps BLOCK_CNT blocks at REGION in a new page table, with 2 MB
+   pages if HUGE is true and 4 kB pages otherwise, and returns the
+   average cycles per load.  The page table is torn down without
+   freeing the blocks. */
+static uint64_t
+measure (size_t block_cnt, bool huge)
+{
+  uint64_t *pml4 = pml4_create ();
+  uint64_t cycles;
+  size_t i, j;
+
+  if (pml4 == NULL)
+    fail ("out of memory for page table");
+  for (i = 0; i < block_cnt; i++)
+    {
+      uint8_t *upage = REGION + i * HPGSIZE;
+
+      if (huge)
+        {
+          if (!pml4_set_huge_page (pml4, upage, blocks[i], true))
+            fail ("could not map 2 MB page");
+        }
+      else
+        for (j = 0; j < HPG_PAGES; j++)
+          if (!pml4_set_page (pml4, upage + j * PGSIZE,
+                              (uint8_t *) blocks[i] + j * PGSIZE, true))
+            fail ("could not map 4 kB page");
+    }
+
+  use_pml4 (pml4);
+  touch (block_cnt * HPG_PAGES);
+  cycles = touch (block_cnt * HPG_PAGES);
+  if (*(uint64_t *) (REGION + 12345) != *(uint64_t *) ((uint8_t *) blocks[0] + 12345))
+    fail ("mapping does not reach the right bytes");
+
+  if (huge)
+    {
+      /* Clearing one page must split the 2 MB page and leave its
+         neighbours alone. */
+      pml4_clear_page (pml4, REGION + PGSIZE);
+      if (pml4_get_page (pml4, REGION + PGSIZE) != NULL)
+        fail ("cleared page still mapped");
+      if (pml4_get_page (pml4, REGION + 2 * PGSIZE + 8)
+          != (uint8_t *) blocks[0] + 2 * PGSIZE + 8)
+        fail ("neighbour of cleared page lost its mapping");
+    }
+
+  /* Unmap everything, so that pml4_destroy() does not free the
+     blocks. */
+  for (i = 0; i < block_cnt * HPG_PAGES; i++)
+    pml4_clear_page (pml4, REGION + i * PGSIZE);
+  use_pml4 (NULL);
+  pml4_destroy (pml4);
+  return cycles;
+}
+
+void
+test_hugepage_bench (void)
+{
+  uint64_t small, huge;
+  size_t block_cnt, page_cnt, i;
+
+  for (block_cnt = 0; block_cnt < MAX_HUGE; block_cnt++)
+    {
+      blocks[block_cnt] = palloc_get_huge_page (PAL_USER | PAL_ZERO);
+      if (blocks[block_cnt] == NULL)
+        break;
+    }
+  if (block_cnt == 0)
+    fail ("no 2 MB aligned run of user pages");
+  page_cnt = block_cnt * HPG_PAGES;
+
+  order = malloc (page_cnt * sizeof *order);
+  if (order == NULL)
+    fail ("out of memory");
+  random_init (0);
+  for (i = 0; i < page_cnt; i++)
+    order[i] = i;
+  for (i = page_cnt - 1; i > 0; i--)
+    {
+      size_t j = random_ulong () % (i + 1);
+      size_t t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+
+  small = measure (block_cnt, false);
+  huge = measure (block_cnt, true);
+  msg ("%zu MB, one load per 4 kB page in shuffled order:",
+       block_cnt * HPGSIZE / (1024 * 1024));
+  msg ("4 kB pages: %llu cycles per load", (unsigned long long) small);
+  msg ("2 MB pages: %llu cycles per load", (unsigned long long) huge);
+
+  free (order);
+  for (i = 0; i < block_cnt; i++)
+    palloc_free_multiple (blocks[i], HPG_PAGES);
+}
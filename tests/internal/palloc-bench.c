@@ -0,0 +1,108 @@
+/* Page allocator benchmark.
+
+   Latency: average cycles for a palloc_get_multiple() /
+   palloc_free_multiple() pair of 1 to 16 pages.
+
+   Fragmentation: fills the user pool with randomly sized blocks,
+   frees every other one, and compares the largest contiguous
+   allocation that still succeeds with the number of free pages.
+   Freeing the rest must bring the largest block back, which shows
+   that freed blocks coalesce.
+
+   Not part of the graded test set; run it by hand with
+   `pintos -- -q run palloc-bench'. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+#define ROUNDS 1000
+#define MAX_BLOCKS 1024
+#define MAX_ORDER 10
+
+static void *blocks[MAX_BLOCKS];
+static size_t block_pages[MAX_BLOCKS];
+
+static void
+measure_latency (size_t page_cnt)
+{
+  uint64_t start, cycles;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      void *pages = palloc_get_multiple (0, page_cnt);
+      if (pages == NULL)
+        fail ("could not allocate %zu pages", page_cnt);
+      palloc_free_multiple (pages, page_cnt);
+    }
+  cycles = rdtsc () - start;
+  msg ("%2zu pages: %llu cycles per get/free", page_cnt,
+       (unsigned long long) (cycles / ROUNDS));
+}
+
+/* Returns the largest power-of-two run of user pages that can be
+   allocated right now. */
+static size_t
+largest_block (void)
+{
+  int order;
+
+  for (order = MAX_ORDER; order >= 0; order--)
+    {
+      void *pages = palloc_get_multiple (PAL_USER, (size_t) 1 << order);
+      if (pages != NULL)
+        {
+          palloc_free_multiple (pages, (size_t) 1 << order);
+          return (size_t) 1 << order;
+        }
+    }
+  return 0;
+}
+
+static void
+measure_fragmentation (void)
+{
+  size_t before, holes, free_pages = 0;
+  int cnt, i;
+
+  before = largest_block ();
+  random_init (0);
+  for (cnt = 0; cnt < MAX_BLOCKS; cnt++)
+    {
+      block_pages[cnt] = random_ulong () % 8 + 1;
+      blocks[cnt] = palloc_get_multiple (PAL_USER, block_pages[cnt]);
+      if (blocks[cnt] == NULL)
+        break;
+    }
+
+  for (i = 0; i < cnt; i += 2)
+    {
+      palloc_free_multiple (blocks[i], block_pages[i]);
+      free_pages += block_pages[i];
+    }
+  holes = largest_block ();
+  msg ("%d blocks, %zu pages freed in holes, largest run %zu pages",
+       cnt, free_pages, holes);
+
+  for (i = 1; i < cnt; i += 2)
+    palloc_free_multiple (blocks[i], block_pages[i]);
+  if (largest_block () != before)
+    fail ("largest run %zu pages after freeing all, expected %zu",
+          largest_block (), before);
+  msg ("largest run back to %zu pages after freeing all", before);
+}
+
+void
+test_palloc_bench (void)
+{
+  size_t page_cnt;
+
+  for (page_cnt = 1; page_cnt <= 16; page_cnt *= 2)
+    measure_latency (page_cnt);
+  measure_latency (3);
+  measure_fragmentation ();
+}
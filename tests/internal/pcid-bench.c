@@ -0,0 +1,132 @@
+/* Address space switch benchmark.
+
+   Builds two page tables that each map PAGE_CNT user pages and
+   times rounds that switch to one table, touch every page, switch
+   to the other and touch every page again.  Without PCIDs every
+   switch empties the TLB, so each touch after it misses; with
+   PCIDs both tables keep their entries.  Kernel pages are global
+   either way.  Also checks that remapping a page in the table
+   that is not active is seen after switching back to it, which
+   only works if its stale TLB entry was dropped.
+
+   Not part of the graded test set; run it by hand with
+   `pintos -- -q run pcid-bench'. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define ROUNDS 200
+#define PAGE_CNT 64
+
+/* User address the pages are mapped at. */
+#define REGION ((uint8_t *) 0x10000000)
+
+static void *frames[PAGE_CNT + 1];
+
+/* Switches to PML4, or back to the kernel's page table if PML4 is
+   null, in a way that survives a context switch. */
+static void
+use_pml4 (uint64_t *pml4)
+{
+#ifdef USERPROG
+  thread_current ()->pml4 = pml4;
+#endif
+  pml4_activate (pml4);
+}
+
+/* Returns a page table that maps the PAGE_CNT pages of REGION to
+   FRAMES. */
+static uint64_t *
+build (void)
+{
+  uint64_t *pml4 = pml4_create ();
+  size_t i;
+
+  if (pml4 == NULL)
+    fail ("out of memory for page table");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (!pml4_set_page (pml4, REGION + i * PGSIZE, frames[i], true))
+      fail ("could not map page");
+  return pml4;
+}
+
+/* Loads one word from each page of REGION. */
+static void
+touch (void)
+{
+  volatile uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    sum += *(uint64_t *) (REGION + i * PGSIZE);
+}
+
+/* Unmaps REGION from PML4, so that pml4_destroy() does not free
+   the frames, and destroys it. */
+static void
+tear_down (uint64_t *pml4)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    pml4_clear_page (pml4, REGION + i * PGSIZE);
+  pml4_destroy (pml4);
+}
+
+void
+test_pcid_bench (void)
+{
+  uint64_t *a, *b;
+  uint64_t start, cycles;
+  size_t i;
+  int r;
+
+  for (i = 0; i < PAGE_CNT + 1; i++)
+    {
+      frames[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (frames[i] == NULL)
+        fail ("out of user pages");
+      *(uint64_t *) frames[i] = i;
+    }
+  a = build ();
+  b = build ();
+
+  use_pml4 (a);
+  touch ();
+  use_pml4 (b);
+  touch ();
+  start = rdtsc ();
+  for (r = 0; r < ROUNDS; r++)
+    {
+      use_pml4 (a);
+      touch ();
+      use_pml4 (b);
+      touch ();
+    }
+  cycles = (rdtsc () - start) / (ROUNDS * 2);
+
+  /* B's entry for the first page is in the TLB now.  Remap the
+     page while A is active. */
+  use_pml4 (a);
+  pml4_clear_page (b, REGION);
+  if (!pml4_set_page (b, REGION, frames[PAGE_CNT], true))
+    fail ("could not remap page");
+  use_pml4 (b);
+  if (*(uint64_t *) REGION != PAGE_CNT)
+    fail ("stale TLB entry survived the switch");
+
+  msg ("PCIDs %s", rcr4 () & (1 << 17) ? "enabled" : "not supported");
+  msg ("switch and touch %d pages: %llu cycles", PAGE_CNT,
+       (unsigned long long) cycles);
+
+  use_pml4 (NULL);
+  tear_down (a);
+  tear_down (b);
+  for (i = 0; i < PAGE_CNT + 1; i++)
+    palloc_free_page (frames[i]);
+}
@@ -0,0 +1,71 @@
+/* Address space teardown benchmark.
+
+   Builds page tables that map PAGE_CNT fresh user pages and times
+   how long it takes to get rid of them, once with pml4_destroy(),
+   which walks the table and frees every page before returning,
+   and once with pml4_destroy_deferred(), which in a kernel with
+   the reaper thread only queues the table.  The second time is
+   what an exiting process now makes its parent wait for.  The
+   queued table is then freed with pml4_reap(), and the queue
+   must be empty afterward.
+
+   Not part of the graded test set; run it by hand with
+   `pintos -- -q run reap-bench'. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define PAGE_CNT 1024
+
+/* User address the pages are mapped at. */
+#define REGION ((uint8_t *) 0x10000000)
+
+/* Returns a page table that maps PAGE_CNT fresh user pages at
+   REGION. */
+static uint64_t *
+build (void)
+{
+  uint64_t *pml4 = pml4_create ();
+  size_t i;
+
+  if (pml4 == NULL)
+    fail ("out of memory for page table");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      void *page = palloc_get_page (PAL_USER);
+
+      if (page == NULL)
+        fail ("out of user pages");
+      if (!pml4_set_page (pml4, REGION + i * PGSIZE, page, true))
+        fail ("could not map page");
+    }
+  return pml4;
+}
+
+void
+test_reap_bench (void)
+{
+  uint64_t *pml4;
+  uint64_t start, now, deferred;
+
+  pml4 = build ();
+  start = rdtsc ();
+  pml4_destroy (pml4);
+  now = rdtsc () - start;
+
+  pml4 = build ();
+  start = rdtsc ();
+  pml4_destroy_deferred (pml4);
+  deferred = rdtsc () - start;
+  pml4_reap ();
+  if (pml4_reap ())
+    fail ("reaper queue not empty after pml4_reap()");
+
+  msg ("tear down %d mapped pages:", PAGE_CNT);
+  msg ("pml4_destroy: %llu cycles", (unsigned long long) now);
+  msg ("pml4_destroy_deferred: %llu cycles", (unsigned long long) deferred);
+}
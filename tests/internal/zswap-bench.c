@@ -0,0 +1,135 @@
+/* Compressed swap benchmark.
+
+   Compresses pages filled with the kinds of data anonymous
+   memory usually holds, checks that each decompresses back to
+   the original, and prints the compressed size and the cycles
+   taken each way.  In kernels with a disk it also times reading
+   one page of sectors from the swap disk, which is what a swap-in
+   from the compressed pool saves.
+
+   Not part of the graded test set; run it by hand with
+   `pintos -- -q run zswap-bench'. */
+
+#include <lz.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+#ifdef FILESYS
+#include "devices/disk.h"
+#endif
+
+#define ROUNDS 16
+
+/* Something a heap page might be full of. */
+struct node
+  {
+    struct node *next;
+    int key;
+    short flags;
+    char tag[4];
+  };
+
+static void
+fill_zero (uint8_t *p)
+{
+  memset (p, 0, PGSIZE);
+}
+
+static void
+fill_nodes (uint8_t *p)
+{
+  struct node *n = (struct node *) p;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *n; i++)
+    {
+      n[i].next = i + 1 < PGSIZE / sizeof *n ? &n[i + 1] : NULL;
+      n[i].key = i * 3;
+      n[i].flags = i % 4 == 0;
+      memcpy (n[i].tag, "node", 4);
+    }
+}
+
+static void
+fill_text (uint8_t *p)
+{
+  static const char words[] = "the quick brown fox jumps over a lazy dog ";
+  size_t i;
+
+  for (i = 0; i < PGSIZE; i++)
+    p[i] = words[(i * 7 / 5) % (sizeof words - 1)];
+}
+
+static void
+fill_random (uint8_t *p)
+{
+  size_t i;
+
+  for (i = 0; i < PGSIZE; i++)
+    p[i] = random_ulong ();
+}
+
+static void
+measure (const char *name, void (*fill) (uint8_t *), uint8_t *page,
+         uint8_t *comp, uint8_t *out)
+{
+  uint64_t start, c_cycles, d_cycles = 0;
+  size_t len = 0;
+  int r;
+
+  fill (page);
+  start = rdtsc ();
+  for (r = 0; r < ROUNDS; r++)
+    len = lz_compress (page, PGSIZE, comp, PGSIZE);
+  c_cycles = (rdtsc () - start) / ROUNDS;
+  if (len != 0)
+    {
+      start = rdtsc ();
+      for (r = 0; r < ROUNDS; r++)
+        if (!lz_decompress (comp, len, out, PGSIZE))
+          fail ("%s: decompression failed", name);
+      d_cycles = (rdtsc () - start) / ROUNDS;
+      if (memcmp (page, out, PGSIZE))
+        fail ("%s: decompressed page differs", name);
+    }
+  msg ("%-6s: %4zu bytes, compress %llu cycles, decompress %llu cycles",
+       name, len, (unsigned long long) c_cycles,
+       (unsigned long long) d_cycles);
+}
+
+void
+test_zswap_bench (void)
+{
+  uint8_t *page = palloc_get_multiple (PAL_ASSERT, 3);
+  uint8_t *comp = page + PGSIZE;
+  uint8_t *out = page + 2 * PGSIZE;
+
+  random_init (0);
+  measure ("zero", fill_zero, page, comp, out);
+  measure ("nodes", fill_nodes, page, comp, out);
+  measure ("text", fill_text, page, comp, out);
+  measure ("random", fill_random, page, comp, out);
+
+#ifdef FILESYS
+  {
+    struct disk *swap = disk_get (1, 1);
+    uint64_t start;
+    size_t i;
+
+    if (swap != NULL && disk_size (swap) >= PGSIZE / DISK_SECTOR_SIZE)
+      {
+        start = rdtsc ();
+        for (i = 0; i < PGSIZE / DISK_SECTOR_SIZE; i++)
+          disk_read (swap, i, out + i * DISK_SECTOR_SIZE);
+        msg ("disk  : read one page in %llu cycles",
+             (unsigned long long) (rdtsc () - start));
+      }
+  }
+#endif
+
+  palloc_free_multiple (page, 3);
+}
@@ -38,6 +38,14 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"palloc-bench", test_palloc_bench},
+    {"slab-bench", test_slab_bench},
+    {"bitmap-bench", test_bitmap_bench},
+    {"string-bench", test_string_bench},
+    {"hugepage-bench", test_hugepage_bench},
+    {"zswap-bench", test_zswap_bench},
+    {"pcid-bench", test_pcid_bench},
+    {"reap-bench", test_reap_bench},
   };
 
 static const char *test_name;
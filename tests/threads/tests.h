@@ -32,6 +32,14 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_palloc_bench;
+extern test_func test_slab_bench;
+extern test_func test_bitmap_bench;
+extern test_func test_string_bench;
+extern test_func test_hugepage_bench;
+extern test_func test_zswap_bench;
+extern test_func test_pcid_bench;
+extern test_func test_reap_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
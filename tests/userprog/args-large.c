@@ -0,0 +1,46 @@
+/* Execs itself with an argument list whose stack frame spans
+   several pages, and checks that every argument arrives intact. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define ARG_CNT 1000
+
+static char cmd[ARG_CNT * 8 + 16];
+
+int
+main (int argc, char *argv[])
+{
+  char expect[16];
+  int i;
+
+  test_name = "args-large";
+
+  if (argc == 1)
+    {
+      char *p = cmd;
+
+      msg ("begin");
+      p += snprintf (p, sizeof cmd, "args-large");
+      for (i = 0; i < ARG_CNT; i++)
+        p += snprintf (p, cmd + sizeof cmd - p, " arg%04d", i);
+      exec (cmd);
+      fail ("exec returned");
+    }
+
+  CHECK (argc == ARG_CNT + 1, "argc = %d", argc);
+  if (((uintptr_t) argv & 7) != 0)
+    fail ("argv must be word-aligned, actually %p", argv);
+  for (i = 0; i < ARG_CNT; i++)
+    {
+      snprintf (expect, sizeof expect, "arg%04d", i);
+      if (strcmp (argv[i + 1], expect))
+        fail ("argv[%d] = '%s', expected '%s'", i + 1, argv[i + 1], expect);
+    }
+  CHECK (argv[argc] == NULL, "argv[argc] = null");
+  msg ("end");
+  return 0;
+}
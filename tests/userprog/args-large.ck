@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(args-large) begin
+(args-large) argc = 1001
+(args-large) argv[argc] = null
+(args-large) end
+args-large: exit(0)
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Pipe throughput benchmark.  A child streams BENCH_BYTES bytes
+   through a pipe in CHUNK-byte writes; the parent reads them and
+   reports elapsed cycles and bytes per thousand cycles.  Not part of
+   the graded test set; run it by hand with `pintos ... run
+   pipe-bench'. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BENCH_BYTES (4 * 1024 * 1024)
+#define CHUNK 1024
+
+static char buf[CHUNK];
+
+void
+test_main (void)
+{
+  long long total = 0;
+  uint64_t start, cycles;
+  int fds[2];
+  int pid, n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  start = rdtsc ();
+  if ((pid = fork ("writer")) == 0)
+    {
+      long long sent;
+
+      close (fds[0]);
+      for (sent = 0; sent < BENCH_BYTES; sent += CHUNK)
+        if (write (fds[1], buf, CHUNK) != CHUNK)
+          fail ("short write");
+      exit (0);
+    }
+
+  close (fds[1]);
+  while ((n = read (fds[0], buf, sizeof buf)) > 0)
+    total += n;
+  cycles = rdtsc () - start;
+  wait (pid);
+
+  if (total != BENCH_BYTES)
+    fail ("read %lld bytes, expected %d", total, BENCH_BYTES);
+  msg ("%lld bytes in %llu cycles (%llu bytes/kcycle)", total,
+       (unsigned long long) cycles,
+       (unsigned long long) (total * 1000 / (cycles ? cycles : 1)));
+}
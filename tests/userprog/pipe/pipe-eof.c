@@ -0,0 +1,32 @@
+/* Checks that a pipe reports end of file once every writing
+   descriptor, including one inherited across fork, is closed, and
+   that writing into a pipe without readers fails. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char c;
+  int fds[2];
+  int pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      write (fds[1], "x", 1);
+      exit (0);
+    }
+  close (fds[1]);
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read one byte");
+  CHECK (read (fds[0], &c, 1) == 0, "read end of file");
+  wait (pid);
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], "x", 1) == -1, "write without reader");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-eof) begin
+(pipe-eof) pipe
+child: exit(0)
+(pipe-eof) read one byte
+(pipe-eof) read end of file
+(pipe-eof) pipe
+(pipe-eof) write without reader
+(pipe-eof) end
+pipe-eof: exit(0)
+EOF
+pass;
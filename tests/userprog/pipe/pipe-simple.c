@@ -0,0 +1,34 @@
+/* Creates a pipe, forks, and has the child send a message through
+   it while the parent reads it back through a dup2()'d descriptor. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char message[] = "Hello through the pipe!";
+
+void
+test_main (void)
+{
+  char buf[sizeof message];
+  int fds[2];
+  int pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      if (write (fds[1], message, sizeof message) != sizeof message)
+        fail ("child: short write");
+      exit (0);
+    }
+
+  close (fds[1]);
+  CHECK (dup2 (fds[0], 20) == 20, "dup2 read end");
+  CHECK (read (20, buf, sizeof buf) == sizeof message, "read from pipe");
+  if (strcmp (buf, message))
+    fail ("read \"%s\", expected \"%s\"", buf, message);
+  msg ("child exit status %d", wait (pid));
+}
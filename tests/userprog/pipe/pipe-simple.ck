@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-simple) begin
+(pipe-simple) pipe
+(pipe-simple) dup2 read end
+(pipe-simple) read from pipe
+child: exit(0)
+(pipe-simple) child exit status 0
+(pipe-simple) end
+pipe-simple: exit(0)
+EOF
+pass;
@@ -0,0 +1,20 @@
+/* Child process run by spawn-fd and spawn-bench.
+   With an argument, writes a message to that descriptor, which it
+   must have inherited from the parent.  Without one, just exits. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+static const char message[] = "Hello from child-spawn!";
+
+int
+main (int argc, char *argv[])
+{
+  test_name = "child-spawn";
+
+  if (argc > 1
+      && write (atoi (argv[1]), message, sizeof message) != sizeof message)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,38 @@
+/* Process launch benchmark.  Starts ROUNDS copies of child-spawn,
+   first with fork() followed by exec(), then with spawn(), and
+   reports the average cycles per launch for each.  Not part of the
+   graded test set; run it by hand with `pintos ... run spawn-bench'. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 32
+
+void
+test_main (void)
+{
+  uint64_t start, fork_cycles, spawn_cycles;
+  int i, pid;
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      if ((pid = fork ("child-spawn")) == 0)
+        exec ("child-spawn");
+      if (wait (pid) != 0)
+        fail ("fork+exec round %d failed", i);
+    }
+  fork_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    if (wait (spawn ("child-spawn")) != 0)
+      fail ("spawn round %d failed", i);
+  spawn_cycles = rdtsc () - start;
+
+  msg ("fork+exec: %llu cycles/launch",
+       (unsigned long long) (fork_cycles / ROUNDS));
+  msg ("spawn: %llu cycles/launch",
+       (unsigned long long) (spawn_cycles / ROUNDS));
+}
@@ -0,0 +1,34 @@
+/* Spawns a child that writes into a pipe through the descriptor it
+   inherited from the parent, and checks that the message arrives. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char message[] = "Hello from child-spawn!";
+
+void
+test_main (void)
+{
+  char buf[sizeof message];
+  char cmd[32];
+  int fds[2];
+  int pid, n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  snprintf (cmd, sizeof cmd, "child-spawn %d", fds[1]);
+
+  /* Report only after wait() so the child's exit line has a fixed
+     place in the output. */
+  pid = spawn (cmd);
+  close (fds[1]);
+  n = read (fds[0], buf, sizeof buf);
+  wait (pid);
+
+  CHECK (pid != -1, "spawn");
+  CHECK (n == sizeof message, "read from inherited pipe");
+  if (strcmp (buf, message))
+    fail ("read \"%s\", expected \"%s\"", buf, message);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-fd) begin
+(spawn-fd) pipe
+child-spawn: exit(0)
+(spawn-fd) spawn
+(spawn-fd) read from inherited pipe
+(spawn-fd) end
+spawn-fd: exit(0)
+EOF
+pass;
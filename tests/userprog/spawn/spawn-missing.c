@@ -0,0 +1,11 @@
+/* Tries to spawn a nonexistent program, which must fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  msg ("spawn(\"no-such-file\"): %d", spawn ("no-such-file"));
+}
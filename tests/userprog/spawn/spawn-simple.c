@@ -0,0 +1,11 @@
+/* Spawns child-simple and waits for it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  msg ("wait(spawn()) = %d", wait (spawn ("child-simple")));
+}
@@ -0,0 +1,46 @@
+/* Dirties every page of a mapping, then gives the frames back
+   with madvise (MADV_DONTNEED).  The data must have reached the
+   file, and touching the mapping again must fault it back in. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGES 4
+
+static char buf[4096];
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  size_t i, j;
+
+  CHECK (create ("data", PAGES * 4096), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK ((map = mmap (ACTUAL, PAGES * 4096, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"data\"");
+  for (i = 0; i < PAGES; i++)
+    memset (ACTUAL + i * 4096, 'a' + i, 4096);
+  CHECK (madvise (map, PAGES * 4096, MADV_DONTNEED) == 0, "madvise dontneed");
+
+  for (i = 0; i < PAGES; i++)
+    {
+      read (handle, buf, sizeof buf);
+      for (j = 0; j < sizeof buf; j++)
+        if (buf[j] != (char) ('a' + i))
+          fail ("byte %zu of page %zu in file is %02hhx", j, i, buf[j]);
+    }
+  msg ("file holds the written data");
+
+  for (i = 0; i < PAGES * 4096; i++)
+    if (ACTUAL[i] != (char) ('a' + i / 4096))
+      fail ("byte %zu of mapping is %02hhx", i, ACTUAL[i]);
+  msg ("mapping holds the written data");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) create "data"
+(madvise-dontneed) open "data"
+(madvise-dontneed) mmap "data"
+(madvise-dontneed) madvise dontneed
+(madvise-dontneed) file holds the written data
+(madvise-dontneed) mapping holds the written data
+(madvise-dontneed) end
+madvise-dontneed: exit(0)
+EOF
+pass;
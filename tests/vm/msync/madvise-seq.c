@@ -0,0 +1,48 @@
+/* Maps a file, advises sequential access and asks for it to be
+   read in ahead of use, then checks every page.  Also checks that
+   bad advice and unmapped ranges are rejected. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGES 32
+
+static char buf[4096];
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  size_t i;
+
+  CHECK (create ("seq", 0), "create \"seq\"");
+  CHECK ((handle = open ("seq")) > 1, "open \"seq\"");
+  for (i = 0; i < PAGES; i++)
+    {
+      memset (buf, 'A' + i % 26, sizeof buf);
+      if (write (handle, buf, sizeof buf) != sizeof buf)
+        fail ("write of page %zu failed", i);
+    }
+  CHECK ((map = mmap (ACTUAL, PAGES * 4096, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"seq\"");
+  CHECK (madvise (map, PAGES * 4096, MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+  CHECK (madvise (map, PAGES * 4096, MADV_WILLNEED) == 0, "madvise willneed");
+
+  for (i = 0; i < PAGES * 4096; i++)
+    if (ACTUAL[i] != (char) ('A' + i / 4096 % 26))
+      fail ("byte %zu of mapping is %02hhx", i, ACTUAL[i]);
+  msg ("mapping holds the file data");
+
+  CHECK (madvise (map, PAGES * 4096, MADV_RANDOM) == 0, "madvise random");
+  CHECK (madvise (map, 4096, 99) == -1, "bad advice fails");
+  CHECK (madvise (ACTUAL + PAGES * 4096, 4096, MADV_WILLNEED) == -1,
+         "madvise of unmapped range fails");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-seq) begin
+(madvise-seq) create "seq"
+(madvise-seq) open "seq"
+(madvise-seq) mmap "seq"
+(madvise-seq) madvise sequential
+(madvise-seq) madvise willneed
+(madvise-seq) mapping holds the file data
+(madvise-seq) madvise random
+(madvise-seq) bad advice fails
+(madvise-seq) madvise of unmapped range fails
+(madvise-seq) end
+madvise-seq: exit(0)
+EOF
+pass;
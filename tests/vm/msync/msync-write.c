@@ -0,0 +1,36 @@
+/* Writes to a file through a mapping and flushes it with msync,
+   then reads the data back with the read system call while the
+   mapping is still in place. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (msync (map, 4096, MS_SYNC) == 0, "msync");
+
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+  CHECK (msync (map, 4096, 0) == -1, "msync with bad flags fails");
+  CHECK (msync ((char *) map + 4096, 4096, MS_SYNC) == -1,
+         "msync of unmapped range fails");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(msync-write) begin
+(msync-write) create "sample.txt"
+(msync-write) open "sample.txt"
+(msync-write) mmap "sample.txt"
+(msync-write) msync
+(msync-write) compare read data against written data
+(msync-write) msync with bad flags fails
+(msync-write) msync of unmapped range fails
+(msync-write) end
+msync-write: exit(0)
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Limits the process to a few frames, then writes and checks an
+   array several times that size, which only works if the process
+   evicts and reloads its own pages.  A forked child must inherit
+   the limit. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LIMIT 32
+#define PAGE_CNT 256
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  pid_t pid;
+  size_t i;
+
+  CHECK (set_rss_limit (LIMIT) == 0, "set limit to %d frames", LIMIT);
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i / PAGE_SIZE + i % 7;
+  msg ("wrote %d pages", PAGE_CNT);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i / PAGE_SIZE + i % 7))
+      fail ("byte %zu is wrong", i);
+  msg ("read them back");
+
+  pid = fork ("child");
+  if (pid == 0)
+    exit (set_rss_limit (0));
+  CHECK (wait (pid) == LIMIT, "child inherits the limit");
+  CHECK (set_rss_limit (-1) == -1, "negative limit rejected");
+}
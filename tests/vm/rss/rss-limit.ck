@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rss-limit) begin
+(rss-limit) set limit to 32 frames
+(rss-limit) wrote 256 pages
+(rss-limit) read them back
+child: exit(32)
+(rss-limit) child inherits the limit
+(rss-limit) negative limit rejected
+(rss-limit) end
+rss-limit: exit(0)
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Checks that processes running the same executable map the same
+   frame for its read-only code, both after fork and after exec. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+static int
+code_frame (void)
+{
+  return (uintptr_t) get_phys_addr ((void *) code_frame) >> 12;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[32];
+  pid_t pid;
+  int frame;
+
+  test_name = "text-share";
+
+  /* Copy started by exec: compare against the frame passed in. */
+  if (argc == 2)
+    return atoi (argv[1]) == code_frame () ? 81 : 0;
+
+  msg ("begin");
+  frame = code_frame ();
+  CHECK (frame != 0, "code is mapped");
+
+  pid = fork ("child");
+  if (pid == 0)
+    exit (code_frame () == frame ? 81 : 0);
+  CHECK (wait (pid) == 81, "forked child shares code frame");
+
+  snprintf (cmd, sizeof cmd, "text-share %d", frame);
+  pid = fork ("child");
+  if (pid == 0)
+    exec (cmd);
+  CHECK (wait (pid) == 81, "exec'd copy shares code frame");
+  msg ("end");
+  return 0;
+}
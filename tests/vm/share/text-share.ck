@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(text-share) begin
+(text-share) code is mapped
+child: exit(81)
+(text-share) forked child shares code frame
+text-share: exit(81)
+(text-share) exec'd copy shares code frame
+(text-share) end
+text-share: exit(0)
+EOF
+pass;
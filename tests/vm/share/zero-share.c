@@ -0,0 +1,54 @@
+/* Checks that untouched pages of a large BSS array all map one
+   zero frame until written, whether by the process itself or by
+   read(), and that writing some of them leaves the rest zero. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Returns the frame number that page PAGE of BUF maps. */
+static uintptr_t
+frame_of (int page)
+{
+  return (uintptr_t) get_phys_addr (buf + page * PAGE_SIZE) >> 12;
+}
+
+void
+test_main (void)
+{
+  static const char data[] = "written by read()";
+  char *dst = buf + 4 * PAGE_SIZE - 4;
+  int fds[2];
+  size_t i;
+
+  /* Page 0 may share its frame with initialized data, so the
+     checks use pages 1 onward. */
+  for (i = PAGE_SIZE; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is not zero", i);
+  CHECK (frame_of (1) == frame_of (PAGE_CNT - 1),
+         "untouched pages share a frame");
+
+  buf[PAGE_SIZE] = 'x';
+  CHECK (frame_of (1) != frame_of (PAGE_CNT - 1),
+         "written page has a frame of its own");
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], data, sizeof data) == (int) sizeof data,
+         "write to pipe");
+  CHECK (read (fds[0], dst, sizeof data) == (int) sizeof data,
+         "read into two untouched pages");
+  CHECK (memcmp (dst, data, sizeof data) == 0, "read data arrived");
+
+  for (i = PAGE_SIZE + 1; i < sizeof buf; i++)
+    if ((buf + i < dst || buf + i >= dst + sizeof data) && buf[i] != 0)
+      fail ("byte %zu is not zero after writes", i);
+  msg ("other pages are still zero");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(zero-share) begin
+(zero-share) untouched pages share a frame
+(zero-share) written page has a frame of its own
+(zero-share) pipe
+(zero-share) write to pipe
+(zero-share) read into two untouched pages
+(zero-share) read data arrived
+(zero-share) other pages are still zero
+(zero-share) end
+zero-share: exit(0)
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Raises the stack limit and uses a stack array larger than the
+   default 1 MB limit.  A forked child must inherit the limit, and
+   a child that lowers it must be killed when its stack grows past
+   the new limit.  The child starts with the 2 MB of stack its
+   parent used, so it has to go below that to fault. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LIMIT 1024
+#define SMALL_LIMIT 64
+
+/* Fills an array of SIZE bytes on the stack and checks it. */
+static void __attribute__ ((noinline))
+use_stack (size_t size)
+{
+  volatile char buf[size];
+  size_t i;
+
+  for (i = 0; i < size; i += PAGE_SIZE / 4)
+    buf[i] = i / PAGE_SIZE;
+  for (i = 0; i < size; i += PAGE_SIZE / 4)
+    if (buf[i] != (char) (i / PAGE_SIZE))
+      fail ("byte %zu is wrong", i);
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  CHECK (set_stack_limit (LIMIT) == 256, "raise limit to %d pages", LIMIT);
+  use_stack (2 * 1024 * 1024);
+  msg ("used a 2 MB stack array");
+
+  pid = fork ("child");
+  if (pid == 0)
+    exit (set_stack_limit (LIMIT));
+  CHECK (wait (pid) == LIMIT, "child inherits the limit");
+
+  pid = fork ("overflow");
+  if (pid == 0)
+    {
+      set_stack_limit (SMALL_LIMIT);
+      use_stack (3 * 1024 * 1024);
+      exit (0);
+    }
+  CHECK (wait (pid) == -1, "stack past a lowered limit is killed");
+  CHECK (set_stack_limit (0) == -1, "zero limit rejected");
+}
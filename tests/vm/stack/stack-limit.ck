@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stack-limit) begin
+(stack-limit) raise limit to 1024 pages
+(stack-limit) used a 2 MB stack array
+child: exit(1024)
+(stack-limit) child inherits the limit
+overflow: exit(-1)
+(stack-limit) stack past a lowered limit is killed
+(stack-limit) zero limit rejected
+(stack-limit) end
+stack-limit: exit(0)
+EOF
+pass;
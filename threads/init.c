@@ -19,6 +19,7 @@
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
 #ifdef USERPROG
@@ -105,6 +106,10 @@ main (void) {
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+#ifdef USERPROG
+	palloc_zero_init ();
+	pml4_reaper_init ();
+#endif
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -155,7 +160,7 @@ paging_init (uint64_t mem_end) {
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -165,6 +170,7 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+	tlb_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -228,6 +234,15 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-rss"))
+			vm_rss_limit = atoi (value);
+		else if (!strcmp (name, "-stack")) {
+			if (!vm_stack_limit_valid (atoi (value)))
+				PANIC ("bad stack limit `%s'", value);
+			vm_stack_limit = atoi (value);
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -330,6 +345,10 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -rss=COUNT         Limit each process to COUNT resident pages.\n"
+			"  -stack=COUNT       Let each process's stack grow to COUNT pages.\n"
 #endif
 			);
 	power_off ();
@@ -356,6 +375,8 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	kmem_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
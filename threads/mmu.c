@@ -2,17 +2,153 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* TLB tagging.
+ *
+ * Kernel mappings carry PTE_G, and with CR4.PGE set a CR3 load
+ * leaves them in the TLB.  If the CPU supports process-context
+ * identifiers (PCIDs), CR4.PCIDE is set as well: the low 12 bits
+ * of CR3 then tag every TLB entry with the address space that
+ * created it, and a CR3 load with CR3_NOFLUSH set keeps the
+ * entries of every tag, so switching between processes no longer
+ * empties the TLB.
+ *
+ * PCIDs are handed out to page tables from a small table, round
+ * robin once it is full; PCID 0 always belongs to base_pml4.  A
+ * PCID may still tag entries of the page table it belonged to
+ * before, so it starts out stale, and the next activation of a
+ * stale PCID flushes it.  invlpg only reaches the current PCID,
+ * so changing an entry of a page table that is not active also
+ * marks that table's PCID stale. */
+#define CR4_PGE (1 << 7)                /* Global pages. */
+#define CR4_PCIDE (1 << 17)             /* PCIDs. */
+#define CPUID_1_EDX_PGE (1 << 13)
+#define CPUID_1_ECX_PCID (1 << 17)
+#define CR3_PCID_MASK 0xfffULL
+#define CR3_NOFLUSH (1ULL << 63)        /* Keep this PCID's entries. */
+
+#define PCID_CNT 64
+
+struct pcid {
+	uint64_t *pml4;                     /* Owner, or null if free. */
+	bool stale;                         /* Flush on next activation? */
+};
+
+static struct pcid pcids[PCID_CNT];
+static unsigned pcid_hand = 1;          /* Next PCID to take back. */
+static bool pcid_enabled;
+
+/* Turns on global pages and, if the CPU has them, PCIDs.  Must be
+ * called once, with base_pml4 active. */
+void
+tlb_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t cr4 = rcr4 ();
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_1_EDX_PGE)
+		cr4 |= CR4_PGE;
+	/* PCIDE may only be set while the current PCID is 0. */
+	if ((ecx & CPUID_1_ECX_PCID) && (rcr3 () & CR3_PCID_MASK) == 0) {
+		cr4 |= CR4_PCIDE;
+		pcids[0].pml4 = base_pml4;
+		pcid_enabled = true;
+	}
+	lcr4 (cr4);
+}
+
+/* Returns the PCID of PML4, giving it one if it has none.  Must be
+ * called with interrupts off. */
+static unsigned
+pcid_get (uint64_t *pml4) {
+	unsigned i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (pml4 == base_pml4)
+		return 0;
+	for (i = 1; i < PCID_CNT; i++)
+		if (pcids[i].pml4 == pml4)
+			return i;
+
+	/* Take a free PCID, or else the one under the hand. */
+	for (i = 1; i < PCID_CNT; i++)
+		if (pcids[i].pml4 == NULL)
+			break;
+	if (i == PCID_CNT) {
+		i = pcid_hand;
+		pcid_hand = pcid_hand % (PCID_CNT - 1) + 1;
+	}
+	pcids[i].pml4 = pml4;
+	pcids[i].stale = true;
+	return i;
+}
+
+/* Marks the PCID of PML4, if it has one, stale.  Must be called
+ * with interrupts off. */
+static void
+pcid_mark_stale (uint64_t *pml4) {
+	for (unsigned i = 0; i < PCID_CNT; i++)
+		if (pcids[i].pml4 == pml4)
+			pcids[i].stale = true;
+}
+
+/* Stores NEW in *PTE, the entry of PML4 for VA, and drops any
+ * TLB entry for VA that PML4 may have left.  Interrupts are off
+ * throughout, so that PML4 cannot be activated between the store
+ * and the invalidation. */
+static void
+pte_update (uint64_t *pml4, uint64_t *pte, uint64_t new, uint64_t va) {
+	enum intr_level old_level = intr_disable ();
+
+	*pte = new;
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		invlpg (va);
+	else if (pcid_enabled)
+		pcid_mark_stale (pml4);
+	intr_set_level (old_level);
+}
+
+/* Replaces the 2 MB mapping in page directory entry PDE by a page
+ * table whose 512 PTEs map the same physical pages with the same
+ * flags, so that single 4 kB pages of it can be changed.  Returns
+ * false, leaving PDE alone, if no page is free for the table.
+ *
+ * The hardware keeps one dirty bit for the whole 2 MB page, so if
+ * it is set every 4 kB page comes out dirty and is written back
+ * when evicted or unmapped.  That costs I/O but loses nothing. */
+static bool
+split_pde (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t perm = *pde & PTE_FLAGS & ~PTE_PS;
+
+	if (pt == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | perm;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		/* Callers of the walk want a 4 kB PTE.  If the 2 MB page
+		 * cannot be split, the walk fails and the caller must leave
+		 * the mapping as it is. */
+		if (((uint64_t) pte & PTE_P) && ((uint64_t) pte & PTE_PS))
+			if (!split_pde (&pdp[idx]))
+				return NULL;
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -60,7 +196,9 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a 2 MB page, that page is first split into
+ * 4 kB pages. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -88,6 +226,38 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the page directory entry for virtual address VA in PML4,
+ * or a null pointer if there is no page directory for VA.  Never
+ * changes any page table. */
+static uint64_t *
+pde_lookup (uint64_t *pml4, const uint64_t va) {
+	uint64_t *pdpe, *pgdir;
+
+	if (!(pml4[PML4 (va)] & PTE_P))
+		return NULL;
+	pdpe = ptov (PTE_ADDR (pml4[PML4 (va)]));
+	if (!(pdpe[PDPE (va)] & PTE_P))
+		return NULL;
+	pgdir = ptov (PTE_ADDR (pdpe[PDPE (va)]));
+	return &pgdir[PDX (va)];
+}
+
+/* Returns the entry that maps virtual address VA in PML4 without
+ * splitting a 2 MB page: the page directory entry itself if VA lies
+ * in one, which the caller can tell by PTE_PS (never set in a 4 kB
+ * PTE here), otherwise the PTE.  Returns a null pointer if there is
+ * no such entry. */
+static uint64_t *
+entry_lookup (uint64_t *pml4, const uint64_t va) {
+	uint64_t *pde = pde_lookup (pml4, va);
+
+	if (pde == NULL || !(*pde & PTE_P))
+		return NULL;
+	if (*pde & PTE_PS)
+		return pde;
+	return (uint64_t *) ptov (PTE_ADDR (*pde)) + PTX (va);
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,6 +292,12 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
+		/* FUNC gets 4 kB PTEs only. */
+		if ((pdp[i] & PTE_P) && (pdp[i] & PTE_PS)) {
+			if (!split_pde (&pdp[i]))
+				return false;
+			pte = ptov((uint64_t *) pdp[i]);
+		}
 		if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
@@ -155,55 +331,179 @@ pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	return true;
 }
 
+/* Pages freed by pml4_destroy(), handed back to the page
+ * allocator FREE_BATCH at a time. */
+#define FREE_BATCH 32
+
+struct free_batch {
+	size_t cnt;
+	void *pages[FREE_BATCH];
+};
+
+static void
+batch_add (struct free_batch *b, void *page) {
+	if (b->cnt == FREE_BATCH) {
+		palloc_free_pages (b->pages, b->cnt);
+		b->cnt = 0;
+	}
+	b->pages[b->cnt++] = page;
+}
+
 static void
-pt_destroy (uint64_t *pt) {
+pt_destroy (uint64_t *pt, struct free_batch *b) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pt[i]);
 		if (((uint64_t) pte) & PTE_P)
-			palloc_free_page ((void *) PTE_ADDR (pte));
+			batch_add (b, (void *) PTE_ADDR (pte));
 	}
-	palloc_free_page ((void *) pt);
+	batch_add (b, pt);
 }
 
 static void
-pgdir_destroy (uint64_t *pdp) {
+pgdir_destroy (uint64_t *pdp, struct free_batch *b) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+		if ((pdp[i] & PTE_P) && (pdp[i] & PTE_PS))
+			palloc_free_multiple ((void *) PTE_ADDR (pte), HPG_PAGES);
+		else if (((uint64_t) pte) & PTE_P)
+			pt_destroy (PTE_ADDR (pte), b);
 	}
-	palloc_free_page ((void *) pdp);
+	batch_add (b, pdp);
 }
 
 static void
-pdpe_destroy (uint64_t *pdpe) {
+pdpe_destroy (uint64_t *pdpe, struct free_batch *b) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
 		if (((uint64_t) pde) & PTE_P)
-			pgdir_destroy ((void *) PTE_ADDR (pde));
+			pgdir_destroy ((void *) PTE_ADDR (pde), b);
 	}
-	palloc_free_page ((void *) pdpe);
+	batch_add (b, pdpe);
 }
 
 /* Destroys pml4e, freeing all the pages it references. */
 void
 pml4_destroy (uint64_t *pml4) {
+	struct free_batch b;
+
 	if (pml4 == NULL)
 		return;
 	ASSERT (pml4 != base_pml4);
 
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
+	b.cnt = 0;
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
-		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+		pdpe_destroy ((void *) PTE_ADDR (pdpe), &b);
+	palloc_free_pages (b.pages, b.cnt);
+
+	/* Give back its PCID.  The next owner starts out stale. */
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		for (unsigned i = 1; i < PCID_CNT; i++)
+			if (pcids[i].pml4 == pml4)
+				pcids[i].pml4 = NULL;
+		intr_set_level (old_level);
+	}
 	palloc_free_page ((void *) pml4);
 }
 
+/* Page tables of exited processes, waiting for the reaper thread.
+ * Exit only has to detach its page table; walking and freeing it
+ * happens later, when nothing else wants the CPU.  When memory
+ * runs short, palloc reaps right away (see pml4_reap()). */
+#define REAP_QUEUE_LEN 32
+static uint64_t *reap_queue[REAP_QUEUE_LEN];
+static size_t reap_cnt;
+static bool reaper_ready;
+static struct semaphore reap_sema;
+
+/* Destroys PML4 like pml4_destroy(), but leaves the work to the
+ * reaper thread if it is running.  PML4 must not be active. */
+void
+pml4_destroy_deferred (uint64_t *pml4) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	if (pml4 == NULL)
+		return;
+	ASSERT (PTE_ADDR (rcr3 ()) != vtop (pml4));
+
+	old_level = intr_disable ();
+	if (reaper_ready && reap_cnt < REAP_QUEUE_LEN) {
+		reap_queue[reap_cnt++] = pml4;
+		queued = true;
+	}
+	intr_set_level (old_level);
+
+	if (queued)
+		sema_up (&reap_sema);
+	else
+		pml4_destroy (pml4);
+}
+
+/* Destroys every page table waiting for the reaper.  Returns true
+ * if there was any. */
+bool
+pml4_reap (void) {
+	bool reaped = false;
+
+	ASSERT (!intr_context ());
+
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		uint64_t *pml4 = reap_cnt > 0 ? reap_queue[--reap_cnt] : NULL;
+		intr_set_level (old_level);
+
+		if (pml4 == NULL)
+			return reaped;
+		pml4_destroy (pml4);
+		reaped = true;
+	}
+}
+
+/* Frees queued page tables as they come in.  Runs at PRI_MIN,
+ * like the pagezero thread. */
+static void
+reaper_thread (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&reap_sema);
+		pml4_reap ();
+	}
+}
+
+/* Starts the reaper thread.  Must be called after thread_start(). */
+void
+pml4_reaper_init (void) {
+	sema_init (&reap_sema, 0);
+	reaper_ready = true;
+	thread_create ("reaper", PRI_MIN, reaper_thread, NULL);
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD survive from its
+ * last activation unless its PCID went stale in between. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	uint64_t cr3;
+	unsigned pcid;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4));
+		return;
+	}
+
+	old_level = intr_disable ();
+	pcid = pcid_get (pml4);
+	cr3 = vtop (pml4) | pcid;
+	if (!pcids[pcid].stale)
+		cr3 |= CR3_NOFLUSH;
+	pcids[pcid].stale = false;
+	lcr3 (cr3);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -214,13 +514,48 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t *pte = entry_lookup (pml4, (uint64_t) uaddr);
 
+	if (pte && (*pte & PTE_P) && (*pte & PTE_PS))
+		return ptov (PTE_ADDR (*pte)) + ((uint64_t) uaddr & HPGMASK);
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
 }
 
+/* Maps the 2 MB of user virtual memory starting at UPAGE in PML4
+ * with a single page directory entry, to the 512 physically
+ * contiguous pages starting at kernel virtual address KPAGE, which
+ * should come from palloc_get_huge_page().  Both must be 2 MB
+ * aligned and no page of the range may be mapped yet; an empty
+ * page table left over for the range is freed.  RW is as for
+ * pml4_set_page().  Returns false if memory allocation failed. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pte, *pde, *pt;
+
+	ASSERT (((uint64_t) upage & HPGMASK) == 0);
+	ASSERT (((uint64_t) kpage & HPGMASK) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	/* Walking with CREATE builds the upper levels and a page table
+	 * for the range, which the PDE then replaces. */
+	pte = pml4e_walk (pml4, (uint64_t) upage, 1);
+	if (pte == NULL)
+		return false;
+	pt = pte - PTX (upage);
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		ASSERT (!(pt[i] & PTE_P));
+
+	pde = pde_lookup (pml4, (uint64_t) upage);
+	pte_update (pml4, pde,
+			vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U,
+			(uint64_t) upage);
+	palloc_free_page (pt);
+	return true;
+}
+
 /* Adds a mapping in page map level 4 PML4 from user virtual page
  * UPAGE to the physical frame identified by kernel virtual address KPAGE.
  * UPAGE must not already be mapped. KPAGE should probably be a page obtained
@@ -243,73 +578,81 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Gives user virtual page UPAGE, if it lies in a 2 MB page in
+ * PML4, a 4 kB PTE of its own by splitting the 2 MB page.  Returns
+ * false, changing nothing, if memory for the page table runs out;
+ * once it returns true, pml4_clear_page() and pml4_set_dirty() on
+ * UPAGE cannot fail. */
+bool
+pml4_split_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde = pde_lookup (pml4, (uint64_t) upage);
+
+	if (pde == NULL || (*pde & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+		return true;
+	return split_pde (pde);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
-void
+ * UPAGE need not be mapped.  Returns false, leaving the mapping
+ * alone, if UPAGE lies in a 2 MB page that cannot be split. */
+bool
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
+	if (!pml4_split_page (pml4, upage))
+		return false;
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
-	if (pte != NULL && (*pte & PTE_P) != 0) {
-		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
-	}
+	if (pte != NULL && (*pte & PTE_P) != 0)
+		pte_update (pml4, pte, *pte & ~PTE_P, (uint64_t) upage);
+	return true;
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
- * Returns false if PML4 contains no PTE for VPAGE. */
+ * Returns false if PML4 contains no PTE for VPAGE.
+ * Inside a 2 MB page, the bit covers the whole 2 MB. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = entry_lookup (pml4, (uint64_t) vpage);
 	return pte != NULL && (*pte & PTE_D) != 0;
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
- * in PML4. */
+ * in PML4.  If VPAGE lies in a 2 MB page that cannot be split, the
+ * bit is left as it is, which at worst costs an extra write-back. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
-	if (pte) {
-		if (dirty)
-			*pte |= PTE_D;
-		else
-			*pte &= ~(uint32_t) PTE_D;
-
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
-	}
+	if (pte)
+		pte_update (pml4, pte,
+				dirty ? *pte | PTE_D : *pte & ~(uint32_t) PTE_D,
+				(uint64_t) vpage);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 has been
  * accessed recently, that is, between the time the PTE was
  * installed and the last time it was cleared.  Returns false if
- * PML4 contains no PTE for VPAGE. */
+ * PML4 contains no PTE for VPAGE.  Inside a 2 MB page, the bit
+ * covers the whole 2 MB. */
 bool
 pml4_is_accessed (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = entry_lookup (pml4, (uint64_t) vpage);
 	return pte != NULL && (*pte & PTE_A) != 0;
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  Inside a 2 MB page, the bit covers the whole 2 MB. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
-	if (pte) {
-		if (accessed)
-			*pte |= PTE_A;
-		else
-			*pte &= ~(uint32_t) PTE_A;
-
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
-	}
+	uint64_t *pte = entry_lookup (pml4, (uint64_t) vpage);
+	if (pte)
+		pte_update (pml4, pte,
+				accessed ? *pte | PTE_A : *pte & ~(uint32_t) PTE_A,
+				(uint64_t) vpage);
 }
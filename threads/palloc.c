@@ -2,14 +2,18 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/mmu.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +28,75 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are kept by a binary buddy allocator:
+   free blocks of 2**ORDER pages sit on per-order free lists, so
+   finding a run of pages takes O(log n) instead of a bitmap scan,
+   and freed blocks merge with their free buddies.  Block
+   alignment is relative to the pool base.  A run that no single
+   free block can hold, because it is larger than the pool's
+   largest block or the free pages are split among smaller blocks,
+   is found by scanning the bitmap instead, with interrupts back
+   on when the caller allows it.  The buddy state is touched with
+   interrupts off rather than under a lock, because do_schedule()
+   frees the pages of dying threads with interrupts already
+   disabled.
+
+   Single pages do not go to the buddy allocator directly.  Each
+   thread keeps a small magazine of free pages per pool, refilled
+   and drained MAG_BATCH pages at a time, so most palloc_get_page()
+   and palloc_free_page() calls never touch the shared pool.
+   palloc_free_pages() returns a whole batch of single pages,
+   such as those of a dead process's page table, with one pool
+   acquisition.  When the pool itself runs dry, the magazines of
+   every thread are flushed back to it before an allocation gives
+   up.  If an allocation fails while page tables are
+   still queued for the reaper (see pml4_destroy_deferred()),
+   they are freed on the spot and the allocation is retried.
+
+   Once palloc_zero_init() has run, a low-priority "pagezero"
+   thread keeps a stack of already zeroed user pages, so that
+   palloc_get_page (PAL_USER | PAL_ZERO) on the page fault path
+   does not have to clear 4 kB first.  Those pages are handed out
+   to any user request once the pool itself runs dry.
+
+   palloc_get_huge_page() takes 2 MB aligned runs of 512 pages
+   from the same free lists, for mapping with a single page
+   directory entry. */
+
+/* Bound on the order of a buddy block.  Each pool uses orders up
+   to the largest block that fits in it, so that any run of pages
+   the pool can hold may be allocated. */
+#define BUDDY_MAX_ORDER 32
+
+/* Pages moved between a magazine and its pool at once. */
+#define MAG_BATCH (PALLOC_MAG_SIZE / 2)
+
+/* Times pool_scan() looks again after the run it found was taken
+   while interrupts were on. */
+#define SCAN_TRIES 4
+
+/* Buddy state of one page.  Kept outside the page itself, since
+   free pages are not yet mapped when the pools are populated. */
+struct buddy_page {
+	struct list_elem elem;          /* Free list element. */
+	int8_t order;                   /* Order if a free block head, else -1. */
+};
 
-/* A memory pool. */
+/* A memory pool.  It used to be guarded by a lock; now every
+   field, and the magazines of all threads, are changed only with
+   interrupts off.  A lock cannot be acquired there: do_schedule()
+   frees a dying thread's pages with interrupts already disabled,
+   and a lock held by a preempted thread would make it block. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	struct buddy_page *pages;       /* Buddy state, one per page. */
+	int max_order;                  /* Order of the largest block. */
+	struct list free_list[BUDDY_MAX_ORDER + 1]; /* Free blocks by order. */
+	size_t free_cnt;                /* Pages in the free lists. */
+	size_t cached_cnt;              /* Pages in threads' magazines. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +104,35 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Pre-zeroed user pages.  The pagezero thread refills the stack
+   to ZERO_POOL_PAGES when it drops below ZERO_POOL_LOW. */
+#define ZERO_POOL_PAGES 32
+#define ZERO_POOL_LOW 16
+static void *zero_pages[ZERO_POOL_PAGES];
+static size_t zero_cnt;
+static bool zero_wanted;                /* Wakeup already requested. */
+static bool zero_ready;                 /* pagezero thread running. */
+static struct semaphore zero_sema;      /* Wakes the pagezero thread. */
+
+/* Statistics. */
+static long long request_cnt;   /* # of page gets and frees. */
+static long long acquire_cnt;   /* # of times a pool was entered. */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static size_t pool_scan (struct pool *, size_t page_cnt, enum intr_level);
+static void *pool_get (struct pool *, size_t page_cnt);
+static struct palloc_magazine *current_magazine (struct pool *);
+static void *magazine_get (struct pool *);
+static void *zero_pool_get (void);
+static void magazine_put (struct pool *, void *page);
+static void magazine_flush (struct pool *, struct palloc_magazine *,
+		size_t page_cnt);
+static bool magazines_reclaim (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -224,11 +315,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,20 +355,30 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = NULL;
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
-	void *pages;
+	if (page_cnt == 1 && pool == &user_pool && (flags & PAL_ZERO)) {
+		pages = zero_pool_get ();
+		if (pages != NULL)
+			return pages;
+	}
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 1)
+		pages = magazine_get (pool);
+	else if (page_cnt > 1)
+		pages = pool_get (pool, page_cnt);
+	if (pages == NULL && page_cnt == 1 && pool == &user_pool)
+		pages = zero_pool_get ();
+
+	/* Page tables of exited processes may still be waiting for
+	   the reaper; free them now and try once more. */
+	if (pages == NULL && page_cnt > 0 && !intr_context () && pml4_reap ())
+		return palloc_get_multiple (flags, page_cnt);
 
 	if (pages) {
 		if (flags & PAL_ZERO)
-			memset (pages, 0, PGSIZE * page_cnt);
+			for (size_t i = 0; i < page_cnt; i++)
+				memzero_page ((uint8_t *) pages + i * PGSIZE);
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
@@ -296,11 +399,63 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
+/* Obtains HPG_PAGES contiguous free pages whose physical address
+   is 2 MB aligned, so that they can be mapped by one page
+   directory entry, and returns the kernel virtual address of the
+   first.  FLAGS are as for palloc_get_multiple().  The pages may
+   be freed all together or one by one. */
+void *
+palloc_get_huge_page (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+	size_t skew, get_cnt, page_idx, head;
+
+	/* Buddy blocks are aligned relative to the pool base, which
+	   need not be 2 MB aligned.  If it is not, take a block twice
+	   as large, which always holds an aligned run, and give back
+	   what lies around the run.  The kernel maps physical memory
+	   at a 2 MB aligned KERN_BASE, so virtual alignment is
+	   physical alignment. */
+	skew = pg_no (pool->base) % HPG_PAGES;
+	get_cnt = skew == 0 ? HPG_PAGES : 2 * HPG_PAGES - 1;
+
+	old_level = intr_disable ();
+	request_cnt++;
+	acquire_cnt++;
+	page_idx = buddy_alloc (pool, get_cnt);
+	if (page_idx == BITMAP_ERROR && magazines_reclaim (pool))
+		page_idx = buddy_alloc (pool, get_cnt);
+	if (page_idx == BITMAP_ERROR)
+		page_idx = pool_scan (pool, get_cnt, old_level);
+	if (page_idx != BITMAP_ERROR) {
+		head = (HPG_PAGES - (skew + page_idx) % HPG_PAGES) % HPG_PAGES;
+		if (head > 0)
+			buddy_free_range (pool, page_idx, head);
+		if (get_cnt - head > HPG_PAGES)
+			buddy_free_range (pool, page_idx + head + HPG_PAGES,
+					get_cnt - head - HPG_PAGES);
+		page_idx += head;
+		bitmap_set_multiple (pool->used_map, page_idx, HPG_PAGES, true);
+	}
+	intr_set_level (old_level);
+
+	if (page_idx == BITMAP_ERROR) {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get_huge_page: out of pages");
+		return NULL;
+	}
+	if (flags & PAL_ZERO)
+		for (size_t i = 0; i < HPG_PAGES; i++)
+			memzero_page (pool->base + PGSIZE * (page_idx + i));
+	return pool->base + PGSIZE * page_idx;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -318,8 +473,120 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	if (page_cnt == 1) {
+		magazine_put (pool, pages);
+		return;
+	}
+
+	old_level = intr_disable ();
+	request_cnt++;
+	acquire_cnt++;
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free_range (pool, page_idx, page_cnt);
+	intr_set_level (old_level);
+}
+
+/* Frees the PAGE_CNT single pages listed in PAGES, which need
+   not be contiguous or from the same pool.  The pages go straight
+   back to the buddy allocator, with one pool acquisition for the
+   whole batch instead of one magazine operation per page. */
+void
+palloc_free_pages (void **pages, size_t page_cnt) {
+	enum intr_level old_level;
+	size_t i;
+
+	if (page_cnt == 0)
+		return;
+#ifndef NDEBUG
+	for (i = 0; i < page_cnt; i++)
+		memset (pages[i], 0xcc, PGSIZE);
+#endif
+
+	old_level = intr_disable ();
+	acquire_cnt++;
+	for (i = 0; i < page_cnt; i++) {
+		struct pool *pool = page_from_pool (&kernel_pool, pages[i])
+			? &kernel_pool : &user_pool;
+		size_t page_idx = pg_no (pages[i]) - pg_no (pool->base);
+
+		ASSERT (pg_ofs (pages[i]) == 0);
+		ASSERT (page_from_pool (pool, pages[i]));
+		ASSERT (bitmap_test (pool->used_map, page_idx));
+		request_cnt++;
+		bitmap_reset (pool->used_map, page_idx);
+		buddy_free_range (pool, page_idx, 1);
+	}
+	intr_set_level (old_level);
+}
+
+/* Returns the pages cached in MAGS, a thread's kernel and user
+   magazines, to their pools.  Called before the thread's page is
+   freed. */
+void
+palloc_magazine_drain (struct palloc_magazine mags[2]) {
+	enum intr_level old_level = intr_disable ();
+
+	if (mags[0].cnt > 0) {
+		acquire_cnt++;
+		magazine_flush (&kernel_pool, &mags[0], mags[0].cnt);
+	}
+	if (mags[1].cnt > 0) {
+		acquire_cnt++;
+		magazine_flush (&user_pool, &mags[1], mags[1].cnt);
+	}
+	intr_set_level (old_level);
+}
+
+/* Fills the pre-zeroed page stack whenever it runs low.  Runs at
+   PRI_MIN, so the zeroing happens when nothing else wants the
+   CPU. */
+static void
+pagezero_thread (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&zero_sema);
+		while (zero_cnt < ZERO_POOL_PAGES) {
+			void *page = palloc_get_page (PAL_USER);
+			enum intr_level old_level;
+
+			if (page == NULL)
+				break;
+			memzero_page (page);
+			old_level = intr_disable ();
+			zero_pages[zero_cnt++] = page;
+			intr_set_level (old_level);
+		}
+		zero_wanted = false;
+	}
+}
+
+/* Starts the pagezero thread.  Must be called after thread_start(). */
+void
+palloc_zero_init (void) {
+	sema_init (&zero_sema, 1);
+	zero_wanted = true;
+	zero_ready = true;
+	thread_create ("pagezero", PRI_MIN, pagezero_thread, NULL);
+}
+
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void) {
+	return bitmap_size (user_pool.used_map);
+}
+
+/* Returns how many user pages are free: those in the pool, those
+   cached in threads' magazines and those waiting pre-zeroed. */
+size_t
+palloc_user_free_cnt (void) {
+	return user_pool.free_cnt + user_pool.cached_cnt + zero_cnt;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("Palloc: %lld page requests, %lld pool acquisitions\n",
+			request_cnt, acquire_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -336,15 +603,29 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bp_pages = DIV_ROUND_UP (pgcnt * sizeof (struct buddy_page), PGSIZE)
+		* PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
 
-	*bm_base += bm_pages;
+	/* Buddy state follows the bitmap.  No block is free yet. */
+	p->pages = (struct buddy_page *) ((uint8_t *) *bm_base + bm_pages);
+	memset (p->pages, 0xff, bp_pages);
+	for (order = 0; order <= BUDDY_MAX_ORDER; order++)
+		list_init (&p->free_list[order]);
+	p->max_order = 0;
+	while (p->max_order < BUDDY_MAX_ORDER
+			&& ((uint64_t) 2 << p->max_order) <= pgcnt)
+		p->max_order++;
+	p->free_cnt = 0;
+	p->cached_cnt = 0;
+
+	*bm_base += bm_pages + bp_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -356,3 +637,305 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+buddy_order (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX on its list. */
+static void
+buddy_push (struct pool *pool, size_t page_idx, int order) {
+	pool->pages[page_idx].order = order;
+	list_push_front (&pool->free_list[order], &pool->pages[page_idx].elem);
+	pool->free_cnt += (size_t) 1 << order;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX, merging it with
+   its buddy for as long as the buddy is a free block of the same
+   order. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t pool_pages = bitmap_size (pool->used_map);
+
+	while (order < pool->max_order) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy + ((size_t) 1 << order) > pool_pages
+				|| pool->pages[buddy].order != order)
+			break;
+		list_remove (&pool->pages[buddy].elem);
+		pool->pages[buddy].order = -1;
+		pool->free_cnt -= (size_t) 1 << order;
+		page_idx &= ~((size_t) 1 << order);
+		order++;
+	}
+	buddy_push (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX, as a sequence of
+   the largest aligned blocks that fit. */
+static void
+buddy_free_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < pool->max_order
+				&& (page_idx & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Takes the PAGE_CNT free pages starting at PAGE_IDX out of
+   POOL's free lists.  The blocks holding them are removed whole
+   and the parts lying outside the run go back to the lists. */
+static void
+buddy_take_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+	size_t i = page_idx;
+
+	while (i < end) {
+		size_t head = i;
+		int order;
+
+		/* The free block holding page I is the one whose head is
+		   I rounded down to the block's own size. */
+		for (order = 0; order <= pool->max_order; order++) {
+			head = i & ~(((size_t) 1 << order) - 1);
+			if (pool->pages[head].order == order)
+				break;
+		}
+		ASSERT (order <= pool->max_order);
+
+		list_remove (&pool->pages[head].elem);
+		pool->pages[head].order = -1;
+		pool->free_cnt -= (size_t) 1 << order;
+		if (head < page_idx)
+			buddy_free_range (pool, head, page_idx - head);
+		i = head + ((size_t) 1 << order);
+		if (i > end)
+			buddy_free_range (pool, end, i - end);
+	}
+}
+
+/* Finds PAGE_CNT contiguous free pages by scanning POOL's bitmap,
+   for runs the free lists cannot serve, and takes them out of the
+   lists.  Returns the index of the first, or BITMAP_ERROR.
+
+   Interrupts must be off.  If OLD_LEVEL says the caller had them
+   on, the scan runs with interrupts on again, since it walks the
+   whole pool; the run it finds is then checked once more with
+   interrupts off, because another thread may have taken part of
+   it in the meantime, and the scan is retried if so. */
+static size_t
+pool_scan (struct pool *pool, size_t page_cnt, enum intr_level old_level) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (int try = 0; try < SCAN_TRIES; try++) {
+		size_t page_idx;
+
+		intr_set_level (old_level);
+		page_idx = bitmap_scan (pool->used_map, 0, page_cnt, false);
+		intr_disable ();
+		if (page_idx == BITMAP_ERROR)
+			return BITMAP_ERROR;
+		if (bitmap_none (pool->used_map, page_idx, page_cnt)) {
+			buddy_take_range (pool, page_idx, page_cnt);
+			return page_idx;
+		}
+	}
+	return BITMAP_ERROR;
+}
+
+/* Takes PAGE_CNT contiguous pages out of POOL's free lists and
+   returns the index of the first, or BITMAP_ERROR if there is no
+   such run.  The block is rounded up to a power of two and then
+   split; the unused tail goes straight back to the lists. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) {
+	int want = buddy_order (page_cnt);
+	struct buddy_page *bp;
+	size_t page_idx;
+	int order;
+
+	for (order = want; order <= pool->max_order; order++)
+		if (!list_empty (&pool->free_list[order]))
+			break;
+	if (order > pool->max_order)
+		return BITMAP_ERROR;
+
+	bp = list_entry (list_pop_front (&pool->free_list[order]),
+			struct buddy_page, elem);
+	bp->order = -1;
+	pool->free_cnt -= (size_t) 1 << order;
+	page_idx = bp - pool->pages;
+
+	/* Split down to the wanted order, freeing the upper halves. */
+	while (order > want) {
+		order--;
+		buddy_push (pool, page_idx + ((size_t) 1 << order), order);
+	}
+	if (((size_t) 1 << want) > page_cnt)
+		buddy_free_range (pool, page_idx + page_cnt,
+				((size_t) 1 << want) - page_cnt);
+	return page_idx;
+}
+
+/* Returns the current thread's magazine for POOL. */
+static struct palloc_magazine *
+current_magazine (struct pool *pool) {
+	return &thread_current ()->page_mag[pool == &user_pool];
+}
+
+/* Takes PAGE_CNT pages straight from POOL.  If the pool is short,
+   the pages cached in all threads' magazines go back first and the
+   allocation is retried once. */
+static void *
+pool_get (struct pool *pool, size_t page_cnt) {
+	enum intr_level old_level = intr_disable ();
+	size_t page_idx;
+
+	request_cnt++;
+	acquire_cnt++;
+	page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR && magazines_reclaim (pool))
+		page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR && page_cnt > 1)
+		page_idx = pool_scan (pool, page_cnt, old_level);
+	if (page_idx != BITMAP_ERROR)
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	intr_set_level (old_level);
+
+	return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Moves up to MAG_BATCH pages from POOL into MAG.  Interrupts
+   must be off. */
+static void
+magazine_fill (struct pool *pool, struct palloc_magazine *mag) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (mag->cnt < MAG_BATCH) {
+		size_t page_idx = buddy_alloc (pool, 1);
+		if (page_idx == BITMAP_ERROR)
+			break;
+		bitmap_mark (pool->used_map, page_idx);
+		mag->pages[mag->cnt++] = pool->base + PGSIZE * page_idx;
+		pool->cached_cnt++;
+	}
+}
+
+/* Takes one page from the current thread's magazine for POOL,
+   refilling the magazine with up to MAG_BATCH pages if it is
+   empty.  Returns a null pointer if POOL is out of pages, even
+   counting those cached by other threads. */
+static void *
+magazine_get (struct pool *pool) {
+	enum intr_level old_level = intr_disable ();
+	struct palloc_magazine *mag = current_magazine (pool);
+	void *page = NULL;
+
+	request_cnt++;
+	if (mag->cnt == 0) {
+		acquire_cnt++;
+		magazine_fill (pool, mag);
+		if (mag->cnt == 0 && magazines_reclaim (pool))
+			magazine_fill (pool, mag);
+	}
+	if (mag->cnt > 0) {
+		page = mag->pages[--mag->cnt];
+		pool->cached_cnt--;
+	}
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Puts PAGE into the current thread's magazine for POOL, first
+   draining MAG_BATCH pages to the pool if the magazine is full.
+   Cached pages stay marked as used in the pool's bitmap. */
+static void
+magazine_put (struct pool *pool, void *page) {
+	enum intr_level old_level = intr_disable ();
+	struct palloc_magazine *mag = current_magazine (pool);
+
+	request_cnt++;
+	ASSERT (bitmap_test (pool->used_map, pg_no (page) - pg_no (pool->base)));
+#ifndef NDEBUG
+	for (size_t i = 0; i < mag->cnt; i++)
+		ASSERT (mag->pages[i] != page);
+#endif
+	if (mag->cnt == PALLOC_MAG_SIZE) {
+		acquire_cnt++;
+		magazine_flush (pool, mag, MAG_BATCH);
+	}
+	mag->pages[mag->cnt++] = page;
+	pool->cached_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Returns the last PAGE_CNT pages of MAG to POOL.  Interrupts must
+   be off. */
+static void
+magazine_flush (struct pool *pool, struct palloc_magazine *mag,
+		size_t page_cnt) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (page_cnt <= mag->cnt);
+
+	while (page_cnt-- > 0) {
+		size_t page_idx = pg_no (mag->pages[--mag->cnt]) - pg_no (pool->base);
+		bitmap_reset (pool->used_map, page_idx);
+		buddy_free_range (pool, page_idx, 1);
+		pool->cached_cnt--;
+	}
+}
+
+/* thread_foreach() action that flushes T's magazine for the pool
+   AUX. */
+static void
+magazine_reclaim_thread (struct thread *t, void *aux) {
+	struct pool *pool = aux;
+	struct palloc_magazine *mag = &t->page_mag[pool == &user_pool];
+
+	if (mag->cnt > 0)
+		magazine_flush (pool, mag, mag->cnt);
+}
+
+/* Returns the pages cached in every thread's magazine for POOL,
+   kernel daemons' included, to POOL.  Returns false if there were
+   none.  Interrupts must be off. */
+static bool
+magazines_reclaim (struct pool *pool) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (pool->cached_cnt == 0)
+		return false;
+	acquire_cnt++;
+	thread_foreach (magazine_reclaim_thread, pool);
+	return true;
+}
+
+/* Pops a pre-zeroed user page, or returns a null pointer if there
+   is none.  Wakes the pagezero thread when the stack runs low. */
+static void *
+zero_pool_get (void) {
+	enum intr_level old_level = intr_disable ();
+	void *page = zero_cnt > 0 ? zero_pages[--zero_cnt] : NULL;
+	bool wake = zero_ready && !zero_wanted && zero_cnt < ZERO_POOL_LOW;
+
+	if (wake)
+		zero_wanted = true;
+	intr_set_level (old_level);
+
+	if (wake)
+		sema_up (&zero_sema);
+	return page;
+}
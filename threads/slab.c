@@ -0,0 +1,260 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Object caches for fixed-size kernel structures.
+
+   malloc() rounds every request up to a power of 2, so a 72-byte
+   struct costs 128 bytes and every call goes through the
+   descriptor lock.  A kmem_cache instead serves objects of a
+   single size: each cache owns "slabs", pages that begin with a
+   struct slab header and are cut into objects of exactly that
+   size (rounded up to a pointer).
+
+   Most requests never reach the slabs.  Every thread keeps a
+   short free list per cache in its struct thread.  Allocation
+   pops from that list and freeing pushes onto it, with no lock
+   and no interrupt juggling, since no other thread touches it.
+   When the list runs dry KMEM_BATCH objects are moved over from
+   the slabs under the cache lock; when it grows past
+   KMEM_LOCAL_MAX a batch goes back.  A dying thread hands its
+   lists back in thread_exit().
+
+   A free object's first word links it into whichever free list
+   it is on, so objects come back from kmem_cache_alloc() with
+   unspecified contents.  The cache's constructor, if any, runs
+   on each object before it is returned. */
+
+/* Objects moved between a thread and the slabs at once. */
+#define KMEM_BATCH 8
+
+/* Most objects a thread keeps on one free list. */
+#define KMEM_LOCAL_MAX (2 * KMEM_BATCH)
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Object cache. */
+struct kmem_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	void (*ctor) (void *);      /* Constructor, or null. */
+	struct list partial;        /* Slabs with at least one free object. */
+	struct lock lock;           /* Protects PARTIAL and the slabs. */
+	size_t slab_cnt;            /* Number of slabs owned. */
+	long long alloc_cnt;        /* Objects handed out. */
+	long long free_cnt;         /* Objects given back. */
+	long long refill_cnt;       /* Allocations that took the lock. */
+};
+
+/* Slab header, at the start of each slab page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	size_t free_cnt;            /* Number of free objects. */
+	void *free;                 /* Singly linked free objects. */
+	struct list_elem elem;      /* Element in cache's partial list. */
+};
+
+/* Objects start this far into a slab. */
+#define SLAB_HEADER ROUND_UP (sizeof (struct slab), sizeof (void *))
+
+/* Our set of caches. */
+static struct kmem_cache caches[KMEM_CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void local_refill (struct kmem_cache *, struct kmem_local *);
+static void local_release (struct kmem_cache *, struct kmem_local *,
+		size_t cnt);
+
+/* Creates a cache of objects SIZE bytes long, named NAME.  CTOR,
+   if non-null, initializes each object that kmem_cache_alloc()
+   returns.  Caches are never destroyed. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, void (*ctor) (void *)) {
+	struct kmem_cache *c;
+
+	ASSERT (cache_cnt < KMEM_CACHE_MAX);
+	ASSERT (size <= (PGSIZE - SLAB_HEADER) / 2);
+
+	c = &caches[cache_cnt++];
+	c->name = name;
+	c->obj_size = ROUND_UP (size < sizeof (void *) ? sizeof (void *) : size,
+			sizeof (void *));
+	c->objs_per_slab = (PGSIZE - SLAB_HEADER) / c->obj_size;
+	c->ctor = ctor;
+	list_init (&c->partial);
+	lock_init (&c->lock);
+	return c;
+}
+
+/* Returns the index of cache C, which is also its slot in each
+   thread's kmem_local array. */
+static inline size_t
+cache_idx (struct kmem_cache *c) {
+	return c - caches;
+}
+
+/* Obtains and returns a new object from cache C, or a null
+   pointer if no memory is available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct kmem_local *local = &thread_current ()->kmem_local[cache_idx (c)];
+	void *obj;
+
+	if (local->head == NULL)
+		local_refill (c, local);
+	obj = local->head;
+	if (obj == NULL)
+		return NULL;
+	local->head = *(void **) obj;
+	local->cnt--;
+	c->alloc_cnt++;
+
+	if (c->ctor != NULL)
+		c->ctor (obj);
+	return obj;
+}
+
+/* Returns OBJ, which must have come from cache C, to the cache.
+   A null pointer is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct kmem_local *local;
+
+	if (obj == NULL)
+		return;
+
+	local = &thread_current ()->kmem_local[cache_idx (c)];
+	*(void **) obj = local->head;
+	local->head = obj;
+	local->cnt++;
+	c->free_cnt++;
+
+	if (local->cnt > KMEM_LOCAL_MAX)
+		local_release (c, local, KMEM_BATCH);
+}
+
+/* Gives every object on the running thread's free lists back to
+   the slabs.  Called by a thread on its way out. */
+void
+kmem_thread_drain (void) {
+	struct thread *t = thread_current ();
+	size_t i;
+
+	for (i = 0; i < cache_cnt; i++)
+		if (t->kmem_local[i].cnt > 0)
+			local_release (&caches[i], &t->kmem_local[i], t->kmem_local[i].cnt);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_print_stats (void) {
+	size_t i;
+
+	for (i = 0; i < cache_cnt; i++) {
+		struct kmem_cache *c = &caches[i];
+		size_t block_size = 16;
+
+		while (block_size < c->obj_size)
+			block_size *= 2;
+		printf ("Slab %s: %lld objects in use, %zu slabs, "
+				"%zu bytes each (%zu with malloc), %lld of %lld allocs locked\n",
+				c->name, c->alloc_cnt - c->free_cnt, c->slab_cnt,
+				c->obj_size, block_size, c->refill_cnt, c->alloc_cnt);
+	}
+}
+
+/* Gets a page for cache C and threads all of its objects onto
+   the new slab's free list.  Returns the slab, or a null pointer
+   if no page is available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	uint8_t *obj;
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	s->free = NULL;
+	obj = (uint8_t *) s + SLAB_HEADER + (c->objs_per_slab - 1) * c->obj_size;
+	for (i = 0; i < c->objs_per_slab; i++, obj -= c->obj_size) {
+		*(void **) obj = s->free;
+		s->free = obj;
+	}
+	list_push_front (&c->partial, &s->elem);
+	c->slab_cnt++;
+	return s;
+}
+
+/* Moves up to KMEM_BATCH objects from C's slabs onto LOCAL.
+   Leaves LOCAL empty only if no memory is available. */
+static void
+local_refill (struct kmem_cache *c, struct kmem_local *local) {
+	size_t i;
+
+	lock_acquire (&c->lock);
+	c->refill_cnt++;
+	for (i = 0; i < KMEM_BATCH; i++) {
+		struct slab *s;
+		void *obj;
+
+		if (list_empty (&c->partial) && slab_create (c) == NULL)
+			break;
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+		obj = s->free;
+		s->free = *(void **) obj;
+		if (--s->free_cnt == 0)
+			list_remove (&s->elem);
+
+		*(void **) obj = local->head;
+		local->head = obj;
+		local->cnt++;
+	}
+	lock_release (&c->lock);
+}
+
+/* Moves CNT objects from LOCAL back to the slabs they came from.
+   A slab whose objects are all free is given back to the page
+   allocator, unless it is the only slab C has with free
+   objects. */
+static void
+local_release (struct kmem_cache *c, struct kmem_local *local, size_t cnt) {
+	lock_acquire (&c->lock);
+	while (cnt-- > 0) {
+		void *obj = local->head;
+		struct slab *s = pg_round_down (obj);
+
+		ASSERT (s->magic == SLAB_MAGIC);
+		ASSERT (s->cache == c);
+
+		local->head = *(void **) obj;
+		local->cnt--;
+
+		*(void **) obj = s->free;
+		s->free = obj;
+		if (s->free_cnt++ == 0)
+			list_push_front (&c->partial, &s->elem);
+		else if (s->free_cnt == c->objs_per_slab
+				&& list_next (list_begin (&c->partial)) != list_end (&c->partial)) {
+			list_remove (&s->elem);
+			s->magic = 0;
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+	lock_release (&c->lock);
+}
@@ -336,6 +336,7 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	kmem_thread_drain ();
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
@@ -345,6 +346,21 @@ thread_exit (void) {
 	NOT_REACHED ();
 }
 
+/* Invoke function 'func' on all threads, passing along 'aux'.
+   This function must be called with interrupts off. */
+void
+thread_foreach (thread_action_func *func, void *aux) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+		func (t, aux);
+	}
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -537,6 +553,11 @@ init_thread (struct thread *t, const char *name, int priority) {
 	sema_init(&t->wait_sema,0);
 	sema_init(&t->child_load_sema,0);
 	sema_init(&t->exit_sema,0);
+#ifdef VM
+	list_init(&t->frames);
+	t->rss_limit = vm_rss_limit;
+	t->stack_limit = vm_stack_limit;
+#endif
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -660,6 +681,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
+		palloc_magazine_drain (victim->page_mag);
 		palloc_free_page(victim);
 	}
 	thread_current ()->status = status;
@@ -19,6 +19,7 @@
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #include "threads/synch.h"
+#include "userprog/syscall.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -26,6 +27,7 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void __do_spawn (void *);
 struct thread * find_child(int child_tid);
 /* General process initializer for initd and other process. */
 static void
@@ -33,6 +35,49 @@ process_init (void) {
 	struct thread *current = thread_current ();
 }
 
+/* Longest command line accepted, in pages.  Lets long argument lists
+ * through while bounding the kernel memory a single exec can hold. */
+#define CMDLINE_MAX_PAGES 8
+
+/* Copies CMD_LINE into newly allocated kernel pages.  Returns NULL if it
+ * does not fit in CMDLINE_MAX_PAGES pages or memory is short.  Release
+ * the copy with process_free_cmdline(). */
+char *
+process_copy_cmdline (const char *cmd_line) {
+	size_t size = strnlen (cmd_line, CMDLINE_MAX_PAGES * PGSIZE) + 1;
+	char *copy;
+
+	if (size > CMDLINE_MAX_PAGES * PGSIZE)
+		return NULL;
+	copy = palloc_get_multiple (0, DIV_ROUND_UP (size, PGSIZE));
+	if (copy != NULL)
+		memcpy (copy, cmd_line, size);
+	return copy;
+}
+
+/* Frees a copy made by process_copy_cmdline().  load() leaves the
+ * string intact, so its length still gives the page count. */
+void
+process_free_cmdline (char *cmd_line) {
+	palloc_free_multiple (cmd_line,
+			DIV_ROUND_UP (strlen (cmd_line) + 1, PGSIZE));
+}
+
+/* Stores the program name of CMD_LINE, truncated, in NAME as a thread
+ * name. */
+static void
+cmdline_name (const char *cmd_line, char name[16]) {
+	size_t len;
+
+	while (*cmd_line == ' ')
+		cmd_line++;
+	len = strcspn (cmd_line, " ");
+	if (len > 15)
+		len = 15;
+	memcpy (name, cmd_line, len);
+	name[len] = '\0';
+}
+
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
  * The new thread may be scheduled (and may even exit)
  * before process_create_initd() returns. Returns the initd's
@@ -41,19 +86,18 @@ process_init (void) {
 int
 process_create_initd (const char *file_name) {
 	char *fn_copy;
+	char name[16];
 	int tid;
-	char **ptr;
 	/* Make a copy of FILE_NAME.
 	 * Otherwise there's a race between the caller and load(). */
-	fn_copy = palloc_get_page (0);
+	fn_copy = process_copy_cmdline (file_name);
 	if (fn_copy == NULL)
 		return TID_ERROR;
-	strlcpy (fn_copy, file_name, PGSIZE);
-	strtok_r(file_name," ",ptr);
+	cmdline_name (file_name, name);
 	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy);
+	tid = thread_create (name, PRI_DEFAULT, initd, fn_copy);
 	if (tid == TID_ERROR)
-		palloc_free_page (fn_copy);
+		process_free_cmdline (fn_copy);
 	return tid;
 }
 
@@ -106,12 +150,12 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	if(parent_page == NULL)
 		return false;
 
-	newpage = palloc_get_page(PAL_USER|PAL_ZERO);
+	newpage = palloc_get_page(PAL_USER);
 	if (newpage == NULL) {
 		return false;
 	}
 
-	memcpy(newpage,parent_page,PGSIZE);
+	memcpy_page(newpage,parent_page);
 	writable = is_writable(pte);
 
 	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
@@ -145,6 +189,9 @@ __do_fork (void *aux) {
 
 	process_activate (current);
 #ifdef VM
+	// frame 한도와 stack 한도는 부모에게서 물려받음
+	current->rss_limit = parent->rss_limit;
+	current->stack_limit = parent->stack_limit;
 	supplemental_page_table_init (&current->spt);
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
@@ -161,13 +208,12 @@ __do_fork (void *aux) {
 	if (parent->fd_idx == FDT_COUNT_LIMIT){
 			goto error;
 		}
+	/* Parent and child share each open file description, so a fork
+	 * only takes another reference per descriptor. */
 	for (int i = 0; i < FDT_COUNT_LIMIT ;i++){
 		struct file *file = parent->files[i];
 		if (file > 2)
-		{	file = file_duplicate(file);
-			if (!file)
-				goto error;	
-		}
+			file = file_dup(file);
 		current->files[i] = file;
 	}
 	//printf("name:%s, files0:%d files1:%d\n",thread_current()->name,thread_current()->files[0],thread_current()->files[1]);
@@ -182,6 +228,97 @@ error:
 	exit(-1);
 }
 
+/* Arguments handed from process_spawn() to __do_spawn().  Lives on the
+ * parent's stack, which stays valid because the parent waits on the
+ * child's child_load_sema. */
+struct spawn_args {
+	struct thread *parent;
+	char *cmd_line;
+#ifdef VM
+	size_t rss_limit;
+	size_t stack_limit;
+#endif
+};
+
+/* Starts CMD_LINE as a new child of the current process.  Unlike fork
+ * followed by exec, the child never sees a copy of the parent's address
+ * space: it loads the executable directly and only takes a reference to
+ * each of the parent's open files.  Returns the new process's thread id,
+ * or TID_ERROR if the thread cannot be created or the load fails. */
+int
+process_spawn (const char *cmd_line) {
+	struct spawn_args args;
+	char name[16];
+	int child_tid;
+
+	args.parent = thread_current ();
+#ifdef VM
+	// fork와 마찬가지로 frame 한도와 stack 한도를 물려줌
+	args.rss_limit = args.parent->rss_limit;
+	args.stack_limit = args.parent->stack_limit;
+#endif
+	args.cmd_line = process_copy_cmdline (cmd_line);
+	if (args.cmd_line == NULL)
+		return TID_ERROR;
+	// 스레드 이름은 첫 번째 인자(실행 파일 이름)
+	cmdline_name (args.cmd_line, name);
+
+	child_tid = thread_create (name, PRI_DEFAULT, __do_spawn, &args);
+	if (child_tid == TID_ERROR) {
+		process_free_cmdline (args.cmd_line);
+		return TID_ERROR;
+	}
+	struct thread *t = find_child (child_tid);
+	sema_down (&t->child_load_sema);
+	if (t->exit_status == TID_ERROR)
+		return TID_ERROR;
+	return child_tid;
+}
+
+/* A thread function that loads the spawned executable. */
+static void
+__do_spawn (void *aux) {
+	struct spawn_args *args = (struct spawn_args *) aux;
+	struct thread *parent = args->parent;
+	struct thread *current = thread_current ();
+	char *cmd_line = args->cmd_line;
+	struct intr_frame if_;
+	bool success;
+
+#ifdef VM
+	current->rss_limit = args->rss_limit;
+	current->stack_limit = args->stack_limit;
+	supplemental_page_table_init (&current->spt);
+#endif
+	process_init ();
+
+	/* The parent is blocked until we signal, so its table is stable. */
+	for (int i = 0; i < FDT_COUNT_LIMIT; i++) {
+		struct file *file = parent->files[i];
+		if (file > 2)
+			file = file_dup (file);
+		current->files[i] = file;
+	}
+	current->fd_idx = parent->fd_idx;
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+
+	success = load (cmd_line, &if_);
+	process_free_cmdline (cmd_line);
+	if (!success) {
+		/* Never became a user process, so exit quietly. */
+		current->exit_status = TID_ERROR;
+		sema_up (&current->child_load_sema);
+		thread_exit ();
+	}
+	sema_up (&current->child_load_sema);
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int
@@ -203,7 +340,7 @@ process_exec (void *f_name) {
 	
 	success = load (file_name, &_if);
 	/* If load failed, quit. */
-	palloc_free_page (f_name);
+	process_free_cmdline (f_name);
 	if (!success)
 		return -1;
 	/* Start switched process. */
@@ -287,10 +424,12 @@ process_cleanup (void) {
 		 * process page directory.  We must activate the base page
 		 * directory before destroying the process's page
 		 * directory, or our active page directory will be one
-		 * that's been freed (and cleared). */
+		 * that's been freed (and cleared).  The page directory
+		 * itself is freed later by the reaper thread, so that our
+		 * parent does not wait for it. */
 		curr->pml4 = NULL;
 		pml4_activate (NULL);
-		pml4_destroy (pml4);
+		pml4_destroy_deferred (pml4);
 	}
 }
 
@@ -358,42 +497,79 @@ struct ELF64_PHDR {
 #define ELF ELF64_hdr
 #define Phdr ELF64_PHDR
 
-static bool setup_stack (struct intr_frame *if_);
+static bool setup_stack (struct intr_frame *if_, size_t page_cnt);
 static bool validate_segment (const struct Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
 
-void place_stack(char *args[128],int *args_size,int cnt,struct intr_frame *if_){
-	int sum_size = 0;
-	uintptr_t ptr_list[cnt];
-	int padding_size;
-	
-	for(int i = cnt-1; i !=-1; i-- ){
-		if_->rsp -= args_size[i];
-		ptr_list[i] = if_->rsp;
-		sum_size += args_size[i];
-		memcpy(if_->rsp,args[i],args_size[i]);
-	}
-
-	padding_size = 8-(sum_size%8);
+/* Argument frame built by load().  SIZE bytes are placed directly
+ * below USER_STACK, so the frame starts at USER_STACK - SIZE. */
+struct arg_frame {
+	const char *cmd_line;       /* Source command line, not modified. */
+	int argc;
+	size_t str_bytes;           /* Argument strings, including NULs. */
+	size_t size;                /* Whole frame, see arg_frame_layout(). */
+};
 
-	if_->rsp -= padding_size;
-	memset(if_->rsp,0,padding_size);
+/* Computes the layout of CMD_LINE's argument frame in a single pass.
+ * From the final rsp upward the frame holds a fake return address,
+ * argv[0..argc] (argv[argc] is NULL), padding and the strings, which end
+ * at USER_STACK.  SIZE is chosen so that rsp + 8 is 16-byte aligned, as
+ * at the entry of any x86-64 function. */
+static void
+arg_frame_layout (struct arg_frame *af, const char *cmd_line) {
+	const char *p = cmd_line;
+
+	af->cmd_line = cmd_line;
+	af->argc = 0;
+	af->str_bytes = 0;
+	while (*p != '\0') {
+		if (*p == ' ') {
+			p++;
+			continue;
+		}
+		size_t len = strcspn (p, " ");
+		af->argc++;
+		af->str_bytes += len + 1;
+		p += len;
+	}
+	af->size = ROUND_UP (af->str_bytes + (af->argc + 1) * sizeof (char *), 16)
+		+ sizeof (void *);
+}
 
-	for (int i = cnt; i >=0; i--) 
-	{ 
-		if_->rsp -= 8; 
-		if (i == cnt) { 
-			memset(if_->rsp, 0, sizeof(char *));
-		} else { 
-			memcpy(if_->rsp,&ptr_list[i], sizeof(char *));
+/* Writes the frame described by AF straight onto the user stack, which
+ * must already map AF->size bytes below USER_STACK in the current page
+ * table.  Sets rsp, rdi (argc) and rsi (argv). */
+static void
+arg_frame_push (const struct arg_frame *af, struct intr_frame *if_) {
+	uint8_t *frame = (uint8_t *) USER_STACK - af->size;
+	char **argv = (char **) (frame + sizeof (void *));
+	char *str = (char *) frame + af->size - af->str_bytes;
+	const char *p = af->cmd_line;
+	int i = 0;
+
+	while (*p != '\0') {
+		if (*p == ' ') {
+			p++;
+			continue;
 		}
+		size_t len = strcspn (p, " ");
+		argv[i++] = str;
+		memcpy (str, p, len);
+		str[len] = '\0';
+		str += len + 1;
+		p += len;
 	}
-	if_->rsp -= 8;
-	memset(if_->rsp, 0, sizeof(void *));
-	if_->R.rsi = if_->rsp+8;
-	if_->R.rdi = cnt;
+	/* Fake return address, then argv[argc] and the padding up to the
+	 * strings. */
+	*(void **) frame = NULL;
+	memset (&argv[i], 0,
+			(uint8_t *) USER_STACK - af->str_bytes - (uint8_t *) &argv[i]);
+
+	if_->rsp = (uintptr_t) frame;
+	if_->R.rdi = af->argc;
+	if_->R.rsi = (uintptr_t) argv;
 }
 /* Loads an ELF executable from FILE_NAME into the current thread.
  * Stores the executable's entry point into *RIP
@@ -407,19 +583,22 @@ load (const char *file_name, struct intr_frame *if_) {
 	off_t file_ofs;
 	bool success = false;
 	int i;
-	char *s = file_name;
-
-	char *token, *save_ptr;
-	char *args[64];  // 문자열을 가리키는 포인터 배열
-	int cnt = 0;
-	int args_size[64];
-
-	for (token = strtok_r(s, " ", &save_ptr); token != NULL; token = strtok_r(NULL, " ", &save_ptr))
-	{
-		args[cnt] = token;
-		args_size[cnt] = strlen(token) + 1;
-		cnt++;
-	}
+	struct arg_frame af;
+	char prog[NAME_MAX + 2];
+	size_t len;
+
+	// 명령줄은 그대로 두고 인자 배치만 계산
+	arg_frame_layout (&af, file_name);
+	while (*file_name == ' ')
+		file_name++;
+	/* A name longer than NAME_MAX is cut to NAME_MAX + 1 characters,
+	 * which cannot name an existing file, so the open below fails. */
+	len = strcspn (file_name, " ");
+	if (len > NAME_MAX + 1)
+		len = NAME_MAX + 1;
+	memcpy (prog, file_name, len);
+	prog[len] = '\0';
+	file_name = prog;
 	/* Allocate and activate page directory. */
 	t->pml4 = pml4_create ();
 	if (t->pml4 == NULL)
@@ -508,14 +687,14 @@ load (const char *file_name, struct intr_frame *if_) {
 		}
 	}
 	/* Set up stack. */
-	if (!setup_stack (if_))
+	if (!setup_stack (if_, DIV_ROUND_UP (af.size, PGSIZE)))
 	{	
 		printf("[FAIL]setup_stack\n");
 		goto done;
 	}
 	/* Start address. */
 	if_->rip = ehdr.e_entry;
-	place_stack(args,args_size,cnt,if_);
+	arg_frame_push (&af, if_);
 	success = true;
 	
 done:
@@ -632,20 +811,24 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	return true;
 }
 
-/* Create a minimal stack by mapping a zeroed page at the USER_STACK */
+/* Create a stack by mapping PAGE_CNT zeroed pages below USER_STACK */
 static bool
-setup_stack (struct intr_frame *if_) {
+setup_stack (struct intr_frame *if_, size_t page_cnt) {
 	uint8_t *kpage;
-	bool success = false;
-	kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-	if (kpage != NULL) {
-		success = install_page (((uint8_t *) USER_STACK) - PGSIZE, kpage, true);
-		if (success)
-			if_->rsp = USER_STACK;
-		else
+	size_t i;
+
+	/* Pages already installed are freed with the page table. */
+	for (i = 1; i <= page_cnt; i++) {
+		kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (kpage == NULL)
+			return false;
+		if (!install_page (((uint8_t *) USER_STACK) - i * PGSIZE, kpage, true)) {
 			palloc_free_page (kpage);
+			return false;
+		}
 	}
-	return success;
+	if_->rsp = USER_STACK;
+	return true;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -670,22 +853,9 @@ install_page (void *upage, void *kpage, bool writable) {
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
-/* An open file. */
-struct file {
-	struct inode *inode;        /* File's inode. */
-	off_t pos;                  /* Current position. */
-	bool deny_write;            /* Has file_deny_write() been called? */
-};
-bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-	struct file_info *file_info = (struct file_info *)aux;
-	struct file *file = file_info->file;
-	struct frame *frame = page->frame;
-	int file_size = file_length(file);
-	
+/* PAGE가 어디서 왔는지 file page에 기록 */
+static void
+lazy_load_info (struct page *page, struct file_info *file_info) {
 	switch (page->operations->type)
 	{
 		case VM_ANON:
@@ -693,22 +863,77 @@ lazy_load_segment (struct page *page, void *aux) {
 			break;
 		case VM_FILE:
 			// printf("file page load {%p}\n",page->va);
-			page->file.file = file;
+			page->file.file = file_info->file;
 			page->file.length = file_info->length;
 			page->file.offset = file_info->offset;
+			page->file.bytes = file_info->bytes;
+			break;
+		default:
 			break;
 	}
+}
+
+bool
+lazy_load_segment (struct page *page, void *aux) {
+	/* TODO: Load the segment from the file */
+	/* TODO: This called when the first page fault occurs on address VA. */
+	/* TODO: VA is available when calling this function. */
+	struct file_info *file_info = (struct file_info *)aux;
+	struct file *file = file_info->file;
+	struct frame *frame = page->frame;
+	int file_size = file_length(file);
+	
+	lazy_load_info (page, file_info);
 	// printf("offset : %d\n",file_info->offset);
 	file_seek(file,file_info->offset);
-	int off_set = file_read(file,page->va,file_info->bytes);
+	// user 주소로 읽으면 PTE가 dirty가 되므로 kva로 읽음
+	int off_set = file_read(file,frame->kva,file_info->bytes);
 	// printf("off_set:%d\n",off_set);
 	// printf("PGSIZE-off_set:%d\n",PGSIZE-off_set);
 	memset((frame->kva)+(off_set),0,PGSIZE-off_set);
-	// print_spt();
 	// printf("[END] lazy_load_segment \n");
 	return true;
 }
 
+/* Fault-around: loads the CNT uninit pages starting at FIRST, already
+ * mapped, whose lazy_load_segment() file_info's continue each other in one
+ * file, in one pass under a single acquisition of filesys_lock.  Each page
+ * is read through its frame's kernel address, so the user mappings, which
+ * may be read-only, are neither written nor marked dirty.  Bytes past the
+ * end of the file read as zeros. */
+void
+lazy_load_run (struct page *first, size_t cnt) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct file_info *first_info = first->uninit.aux;
+	off_t ofs = first_info->offset;
+	bool short_read = false;
+	// read() 도중의 fault라면 이미 filesys_lock을 잡고 있음
+	bool locked = lock_held_by_current_thread (&filesys_lock);
+
+	if (!locked)
+		lock_acquire (&filesys_lock);
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *page = spt_find_page (spt, first->va + i * PGSIZE);
+		struct file_info *file_info = page->uninit.aux;
+		off_t done = 0;
+
+		if (!short_read) {
+			done = file_read_at (first_info->file, page->frame->kva,
+					file_info->bytes, ofs);
+			short_read = done < (off_t) file_info->bytes;
+		}
+		ofs += file_info->bytes;
+		memset (page->frame->kva + done, 0, PGSIZE - done);
+
+		// 내용은 이미 읽었으니 init 없이 page type만 바꿈
+		page->uninit.init = NULL;
+		swap_in (page, page->frame->kva);
+		lazy_load_info (page, file_info);
+	}
+	if (!locked)
+		lock_release (&filesys_lock);
+}
+
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -733,6 +958,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 	
+	// 세그먼트 전체에 대한 SPT 공간을 한 번에 확보
+	if (!spt_reserve_range (&thread_current ()->spt, upage,
+				(read_bytes + zero_bytes) / PGSIZE))
+		return false;
+
 	file_seek(file,ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
@@ -742,19 +972,20 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct file_info *file_info = calloc(sizeof(struct file_info),1);
+		struct file_info *file_info = kmem_cache_alloc (file_info_slab);
 		file_info->file = file;
 		file_info->offset = ofs;
 		file_info->bytes = page_read_bytes;
 		void *aux = file_info;
-		enum vm_type type = writable ? (VM_ANON | IS_WRITABLE) : VM_ANON;
+		// 읽기 전용 segment는 같은 실행 파일을 쓰는 프로세스끼리 frame 공유
+		enum vm_type type = writable ? (VM_ANON | IS_WRITABLE) : (VM_ANON | IS_SHARED);
 		// VM_ANON : 익명 페이지 -> 파일에서 데이터를 읽어오는 것이 아니라 
 		// 시스템이 관리하는 메모리 영역 
 		if (!vm_alloc_page_with_initializer (type, upage,
 					writable, lazy_load_segment, aux))
 		{	
 			// printf("[FAIL]load_segment.vm_alloc_page_with_initializer\n");
-			free(file_info);
+			kmem_cache_free (file_info_slab, file_info);
 			return false;
 		}
 		/* Advance. */
@@ -767,19 +998,21 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	return true;
 }
 
-/* Create a PAGE of stack at the USER_STACK. Return true on success. */
+/* Create PAGE_CNT pages of stack below USER_STACK. Return true on success. */
 static bool
-setup_stack (struct intr_frame *if_) {
-	bool success = false;
-	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
+setup_stack (struct intr_frame *if_, size_t page_cnt) {
+	void *stack_bottom = (void *) USER_STACK;
 	//todo writable 저장 필요 type에
-	if(!vm_alloc_page(VM_ANON|IS_STACK|IS_WRITABLE,stack_bottom,true)){
-		// printf("[FAIL] vm_alloc_page\n");
-	}
-	if(!vm_claim_page(stack_bottom))
-	{
-		// printf("[FAIL]setup_stack vm_claim_page\n");
-		return false;
+	for (size_t i = 0; i < page_cnt; i++) {
+		stack_bottom -= PGSIZE;
+		if(!vm_alloc_page(VM_ANON|IS_STACK|IS_WRITABLE,stack_bottom,true)){
+			// printf("[FAIL] vm_alloc_page\n");
+		}
+		if(!vm_claim_page(stack_bottom))
+		{
+			// printf("[FAIL]setup_stack vm_claim_page\n");
+			return false;
+		}
 	}
 	if_->rsp = USER_STACK;
 	thread_current()->stack_bottom = stack_bottom;
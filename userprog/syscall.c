@@ -9,6 +9,8 @@
 #include "intrinsic.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/pipe.h"
+#include "userprog/process.h"
 #include "threads/palloc.h"
 
 void syscall_entry (void);
@@ -25,12 +27,6 @@ void syscall_handler (struct intr_frame *);
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
-/* An open file. */
-struct file {
-	struct inode *inode;        /* File's inode. */
-	off_t pos;                  /* Current position. */
-	bool deny_write;            /* Has file_deny_write() been called? */
-};
 void
 syscall_init (void) {
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
@@ -81,6 +77,8 @@ void check_page(char * addr){
 		if(!IS_WRITABLE(page->file.type))
 			exit(-1);
 		break;
+	default:
+		break;
 	}
 	#endif
 }
@@ -139,6 +137,24 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	case SYS_MUNMAP:
 		munmap(f->R.rdi);
 		break;
+	case SYS_MSYNC:
+		f->R.rax = msync((void *) f->R.rdi,f->R.rsi,f->R.rdx);
+		break;
+	case SYS_MADVISE:
+		f->R.rax = madvise((void *) f->R.rdi,f->R.rsi,f->R.rdx);
+		break;
+	case SYS_SET_RSS_LIMIT:
+		f->R.rax = set_rss_limit(f->R.rdi);
+		break;
+	case SYS_SET_STACK_LIMIT:
+		f->R.rax = set_stack_limit(f->R.rdi);
+		break;
+	case SYS_PIPE:
+		f->R.rax = pipe((int *) f->R.rdi);
+		break;
+	case SYS_SPAWN:
+		f->R.rax = spawn((const char *) f->R.rdi);
+		break;
 	default:
 		break;
 	}
@@ -164,10 +180,9 @@ pid_t fork (const char *thread_name,const struct intr_frame *f){
 int exec (const char *file){
 	// printf("exec start\n");
 	check_addr(file);
-	char *f_copy = palloc_get_page(0);
+	char *f_copy = process_copy_cmdline(file);
 	if(f_copy == NULL)
 		exit(-1);
-	strlcpy(f_copy,file,PGSIZE);
 	int result = process_exec(f_copy);
 	if(result == -1)
 		exit(-1);
@@ -236,18 +251,13 @@ int filesize (int fd){
 		return -1;
 	return file_length(file);
 }
-void pos_update(struct file *file){
-	int i;
-	struct thread *t = thread_current();
-	for (i = 0 ; i < FDT_COUNT_LIMIT; i ++){
-		if(t->files[i] > 2)
-			if(t->files[i]->inode == file->inode)
-				t->files[i]->pos = file_tell(file);
-	}
-}
 int read (int fd, void *buffer, unsigned length){
 	check_addr(buffer);
 	check_page(buffer);
+#ifdef VM
+	// 쓰는 도중에 fault가 나지 않도록 0 frame을 먼저 떼어 냄
+	vm_zero_unshare(buffer, length);
+#endif
 	struct file *file = find_file_by_fd(fd);
 	int bytes_read = 0;
 	char *ptr = (char *)buffer;
@@ -263,13 +273,15 @@ int read (int fd, void *buffer, unsigned length){
 	}else{
 		if (file <3)
 			return -1;
+		// pipe는 블록될 수 있으므로 filesys_lock 없이 읽는다
+		if (file_is_pipe(file))
+			return file_read(file,buffer,length);
 
 		lock_acquire(&filesys_lock);
 		// printf("file_read !!!!\n");
 		bytes_read = file_read(file,buffer,length);
 		// printf("file_read done!!!!%d\n",bytes_read);
 		lock_release(&filesys_lock);
-		pos_update(file);	
 	}
 	// printf("read done\n");
 	return bytes_read;
@@ -288,10 +300,11 @@ int write (int fd, const void *buffer, unsigned length){
 	{
 		if (file < 3)
 			return -1;
+		if (file_is_pipe(file))
+			return file_write(file,buffer,length);
 		lock_acquire(&filesys_lock);
 		byte_write = file_write(file,buffer,length);
 		lock_release(&filesys_lock);
-		pos_update(file);
 	}
 	return byte_write;
 }
@@ -301,7 +314,6 @@ void seek (int fd, unsigned position){
 	if(file < 3)
 		return;
 	file_seek(file,position);
-	pos_update(file);
 }
 // 파일 위치 반환
 unsigned tell (int fd){
@@ -333,9 +345,8 @@ int dup2(int oldfd, int newfd){
 	
 	if (old_file > 2 ){
 		close(newfd);
-		lock_acquire(&filesys_lock);
-		thread_current()->files[newfd] = file_duplicate(old_file);
-		lock_release(&filesys_lock);
+		// 같은 open file description을 공유 (offset 공유)
+		thread_current()->files[newfd] = file_dup(old_file);
 	}else{
 		close(newfd);
 		thread_current()->files[newfd] = old_file;
@@ -346,10 +357,11 @@ int dup2(int oldfd, int newfd){
 void *
 mmap (void *addr, size_t length, int writable, int fd, unsigned int offset) {
 	struct file *file = find_file_by_fd(fd);
-	struct file *new_file = file_duplicate(file);
 	if( file < 3 ){
 		// printf("[FAIL]file < 3\n");
 		return NULL;}
+	if( file_is_pipe(file) )
+		return NULL;
 	if( length == NULL ){
 		// printf("[FAIL]length is NULL\n");
 		return NULL;}
@@ -370,6 +382,9 @@ mmap (void *addr, size_t length, int writable, int fd, unsigned int offset) {
 		return NULL;
 	}
 
+	struct file *new_file = file_duplicate(file);
+	if (new_file == NULL)
+		return NULL;
 	return do_mmap(addr,length,writable,new_file,offset);
 }
 
@@ -379,3 +394,115 @@ munmap (void *addr) {
 		return;
 	do_munmap(addr);
 }
+
+/* Writes back the dirty pages of the mapping in the LENGTH bytes at ADDR.
+ * Returns 0 on success, -1 on failure. */
+int
+msync (void *addr UNUSED, size_t length UNUSED, int flags UNUSED) {
+#ifdef VM
+	return do_msync(addr,length,flags);
+#else
+	return -1;
+#endif
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the LENGTH bytes at ADDR.
+ * Returns 0 on success, -1 on failure. */
+int
+madvise (void *addr UNUSED, size_t length UNUSED, int advice UNUSED) {
+#ifdef VM
+	return do_madvise(addr,length,advice);
+#else
+	return -1;
+#endif
+}
+
+/* Lets the current process hold at most PAGE_CNT frames, or any number if
+ * PAGE_CNT is 0.  Past the limit its faults evict its own pages.  Returns
+ * the old limit, or -1 if PAGE_CNT is negative. */
+int
+set_rss_limit (int page_cnt UNUSED) {
+#ifdef VM
+	struct thread *t = thread_current ();
+	int old = t->rss_limit;
+
+	if (page_cnt < 0)
+		return -1;
+	t->rss_limit = page_cnt;
+	return old;
+#else
+	return -1;
+#endif
+}
+
+/* Lets the current process's stack grow to PAGE_CNT pages.  Pages already
+ * on the stack stay even if the new limit is lower.  Returns the old
+ * limit, or -1 if PAGE_CNT is not a valid limit. */
+int
+set_stack_limit (int page_cnt UNUSED) {
+#ifdef VM
+	struct thread *t = thread_current ();
+	int old = t->stack_limit;
+
+	if (!vm_stack_limit_valid (page_cnt))
+		return -1;
+	t->stack_limit = page_cnt;
+	return old;
+#else
+	return -1;
+#endif
+}
+
+/* Creates a pipe and stores its reading and writing descriptors in
+ * FDS[0] and FDS[1].  Returns 0 on success, -1 on failure. */
+int
+pipe (int *fds) {
+	check_addr((char *) fds);
+	check_addr((char *) (fds + 2) - 1);
+	check_page((char *) fds);
+#ifdef VM
+	vm_zero_unshare(fds, 2 * sizeof *fds);
+#endif
+
+	struct pipe *p = pipe_create();
+	if (p == NULL)
+		return -1;
+	struct file *reader = file_open_pipe(p, false);
+	struct file *writer = file_open_pipe(p, true);
+	if (reader == NULL || writer == NULL) {
+		if (reader != NULL)
+			file_close(reader);
+		else
+			pipe_close(p, false);
+		if (writer != NULL)
+			file_close(writer);
+		else
+			pipe_close(p, true);
+		return -1;
+	}
+
+	int rfd = create_fd(reader);
+	if (rfd == -1)
+		goto fail;
+	int wfd = create_fd(writer);
+	if (wfd == -1) {
+		del_fd(rfd);
+		goto fail;
+	}
+	fds[0] = rfd;
+	fds[1] = wfd;
+	return 0;
+fail:
+	file_close(reader);
+	file_close(writer);
+	return -1;
+}
+
+/* Runs CMD_LINE in a new child process that inherits the caller's open
+ * files but none of its memory.  Returns the child's pid, or -1 if the
+ * program cannot be loaded. */
+pid_t
+spawn (const char *cmd_line) {
+	check_addr(cmd_line);
+	return process_spawn(cmd_line);
+}
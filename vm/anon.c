@@ -1,9 +1,13 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <string.h>
 #include "vm/vm.h"
 #include "devices/disk.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/mmu.h"
 #include "threads/synch.h"
+#include "vm/text.h"
+#include "vm/zswap.h"
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in (struct page *page, void *kva);
@@ -13,6 +17,17 @@ static void anon_destroy (struct page *page);
 struct bitmap *swap_map;
 struct lock swap_lock;
 
+/* Swap cache: pages read ahead from the swap disk, kept until the pages
+ * they belong to fault.  Protected by swap_lock, which is not held during
+ * disk I/O: an entry being read into is marked busy, and is neither handed
+ * out again nor used until the read is done. */
+#define SWAP_CLUSTER 8          /* Pages read per swap-in from disk. */
+#define SWAP_CACHE_PAGES 16
+static uint8_t *swap_cache;
+static int swap_cache_slot[SWAP_CACHE_PAGES];  /* Slot held, or -1. */
+static bool swap_cache_busy[SWAP_CACHE_PAGES]; /* Being read into. */
+static size_t swap_cache_hand;                 /* Next entry to reuse. */
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -28,6 +43,122 @@ vm_anon_init (void) {
 	size_t swap_size = disk_size(swap_disk) / SECTORS_PER_PAGE;
 	swap_map = bitmap_create(swap_size);
 	lock_init(&swap_lock);
+	swap_cache = palloc_get_multiple (PAL_ASSERT, SWAP_CACHE_PAGES);
+	for (size_t i = 0; i < SWAP_CACHE_PAGES; i++)
+		swap_cache_slot[i] = -1;
+	vm_zswap_init ();
+}
+
+/* Reads swap slot SLOT into the page at KVA. */
+static void
+swap_read (int slot, void *kva) {
+	for (int i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_read (swap_disk, slot * SECTORS_PER_PAGE + i,
+				kva + DISK_SECTOR_SIZE * i);
+}
+
+/* Returns the swap cache entry holding SLOT, or -1 if there is none. */
+static int
+swap_cache_find (int slot) {
+	for (int i = 0; i < SWAP_CACHE_PAGES; i++)
+		if (swap_cache_slot[i] == slot)
+			return i;
+	return -1;
+}
+
+/* Returns a swap cache entry that is not being read into, moving the hand
+ * past it, or -1 if every entry is busy. */
+static int
+swap_cache_get (void) {
+	for (int i = 0; i < SWAP_CACHE_PAGES; i++) {
+		int e = swap_cache_hand;
+
+		swap_cache_hand = (e + 1) % SWAP_CACHE_PAGES;
+		if (!swap_cache_busy[e])
+			return e;
+	}
+	return -1;
+}
+
+/* Returns true if PAGE is an anonymous page whose contents are in a slot of
+ * the swap disk. */
+static bool
+is_on_swap_disk (struct page *page) {
+	return page != NULL && VM_TYPE (page->operations->type) == VM_ANON
+		&& page->anon.swap_idx != -1;
+}
+
+/* Reads the pages that follow PAGE, just read from SLOT, in both the
+ * address space and the swap disk into the swap cache, up to
+ * SWAP_CLUSTER - 1 of them.  The entries are taken under swap_lock, which
+ * is dropped for the reads themselves.  An entry whose page is swapped in
+ * or freed meanwhile has its slot reset to -1 and is simply dropped. */
+static void
+swap_read_ahead (struct page *page, int slot) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	int ents[SWAP_CLUSTER], slots[SWAP_CLUSTER];
+	int cnt = 0;
+
+	lock_acquire (&swap_lock);
+	for (int i = 1; i < SWAP_CLUSTER; i++) {
+		struct page *next = spt_find_page (spt, page->va + i * PGSIZE);
+		int e;
+
+		if (!is_on_swap_disk (next) || next->anon.swap_idx != slot + i)
+			break;
+		if (swap_cache_find (slot + i) != -1)
+			continue;
+		e = swap_cache_get ();
+		if (e == -1)
+			break;
+		swap_cache_slot[e] = slot + i;
+		swap_cache_busy[e] = true;
+		ents[cnt] = e;
+		slots[cnt++] = slot + i;
+	}
+	lock_release (&swap_lock);
+
+	for (int i = 0; i < cnt; i++)
+		swap_read (slots[i], swap_cache + ents[i] * PGSIZE);
+
+	lock_acquire (&swap_lock);
+	for (int i = 0; i < cnt; i++)
+		swap_cache_busy[ents[i]] = false;
+	lock_release (&swap_lock);
+}
+
+/* The page written to the swap disk last, by owner and address, and its
+ * slot.  Used only as a placement hint; protected by swap_lock. */
+static struct thread *near_owner;
+static void *near_va;
+static size_t near_slot;
+
+/* Takes a free swap slot for PAGE.  If the page written out just before
+ * was PAGE's neighbour in the same address space, the slot next to its
+ * slot on the same side is preferred, so that neighbouring pages can be
+ * read back with swap_read_ahead().  Only PAGE itself and the hint are
+ * looked at: the owner's supplemental page table may be changing under
+ * kswapd.  Must be called with swap_lock held.  Returns BITMAP_ERROR if
+ * the disk is full. */
+static size_t
+swap_slot_near (struct page *page) {
+	struct thread *owner = page->frame->owner;
+	size_t slot = BITMAP_ERROR;
+
+	if (owner == near_owner && page->va == near_va + PGSIZE)
+		slot = near_slot + 1;
+	else if (owner == near_owner && page->va == near_va - PGSIZE)
+		slot = near_slot - 1;
+	if (slot < bitmap_size (swap_map) && !bitmap_test (swap_map, slot))
+		bitmap_mark (swap_map, slot);
+	else
+		slot = bitmap_scan_and_flip_next (swap_map, 1, false);
+	if (slot != BITMAP_ERROR) {
+		near_owner = owner;
+		near_va = page->va;
+		near_slot = slot;
+	}
+	return slot;
 }
 
 /* Initialize the file mapping */
@@ -40,6 +171,8 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 
 	// 아직 swap_map에 들어가지 않은 상태
 	anon_page->swap_idx = -1;
+	anon_page->zswap_idx = -1;
+	anon_page->zero = false;
 
 	return true;
 }
@@ -49,24 +182,50 @@ static bool
 anon_swap_in (struct page *page, void *kva) {
 	// printf("[START] anon_swap_in {%p}\n",page->va);
 	struct anon_page *anon_page = &page->anon;
+
+	// 압축 pool에 있으면 디스크 대신 메모리에서 풀어 넣음
+	if (anon_page->zswap_idx != -1) {
+		bool success = vm_zswap_load (anon_page->zswap_idx, kva);
+		anon_page->zswap_idx = -1;
+		return success;
+	}
 	
 	int page_no = anon_page->swap_idx;
+	bool cached = false;
+
+	// swap에 내보낸 적이 없는 페이지
+	if (page_no == -1)
+		return false;
 
+	lock_acquire(&swap_lock);
 	// 유효한 swap map 인지 확인
 	if(bitmap_test(swap_map,page_no) == false){
+		lock_release(&swap_lock);
 		return false;
 	}
+	// 앞선 fault에서 미리 읽어 둔 페이지면 디스크를 읽지 않음
+	// 아직 읽는 중인 entry는 버리고 직접 읽음
+	int e = swap_cache_find (page_no);
+	if (e != -1) {
+		cached = !swap_cache_busy[e];
+		if (cached)
+			memcpy (kva, swap_cache + e * PGSIZE, PGSIZE);
+		swap_cache_slot[e] = -1;
+	}
+	lock_release(&swap_lock);
 
-	// 한 페이지의 sector의 개수만큼 sector에서 read
-	for (int i = 0 ; i < SECTORS_PER_PAGE ; i ++)
-	{
-		lock_acquire(&swap_lock);
-		disk_read(swap_disk, page_no * SECTORS_PER_PAGE + i , page->va + DISK_SECTOR_SIZE * i );
-		lock_release(&swap_lock);
+	// slot은 이 페이지만 쓰므로 swap_lock 없이 읽음
+	if (!cached) {
+		swap_read (page_no, kva);
+		// 가상 주소와 slot이 함께 이어지는 다음 페이지들을 미리 읽어 둠
+		swap_read_ahead (page, page_no);
 	}
 
 	// 사용 가능한 swap map으로 변경
+	lock_acquire(&swap_lock);
 	bitmap_set(swap_map,page_no,false);
+	lock_release(&swap_lock);
+	anon_page->swap_idx = -1;
 	// printf("[END] anon_swap_in {%p}\n",page->va);
 	return true;
 }
@@ -77,23 +236,40 @@ anon_swap_out (struct page *page) {
 	// printf("[START] anon_swap_out {%p}\n",page->va);
 	struct anon_page *anon_page = &page->anon;
 
-	// 빈 swap slot 찾기
-	int page_no = bitmap_scan(swap_map,0,1,false);
+	// 다른 프로세스의 frame을 내보낼 수도 있으므로 frame 주인의 페이지 테이블을 씀
+	uint64_t *pml4 = page->frame->owner->pml4;
+
+	// 2 MB 매핑을 나눌 메모리가 없으면 slot을 잡기 전에 실패
+	if (!pml4_split_page (pml4, page->va))
+		return false;
+	// 주인이 계속 실행 중일 수 있으므로 매핑(TLB 포함)을 먼저 지우고 복사
+	// 그 사이의 fault는 vm_try_handle_fault()에서 eviction이 끝나길 기다림
+	pml4_clear_page(pml4,page->va);
+
+	// 압축해서 pool에 들어가면 디스크에는 쓰지 않음
+	anon_page->zswap_idx = vm_zswap_store (page->frame->kva);
+	if (anon_page->zswap_idx != -1)
+		return true;
+
+	// 빈 swap slot 찾기 (바로 전에 내보낸 이웃 페이지의 slot 옆을 먼저, 없으면 직전에 찾은 slot 다음부터)
+	lock_acquire(&swap_lock);
+	size_t page_no = swap_slot_near (page);
+	lock_release(&swap_lock);
+	// 디스크가 가득 찼으면 지웠던 매핑을 되살리고 실패
+	if (page_no == BITMAP_ERROR) {
+		pml4_set_page (pml4, page->va, page->frame->kva,
+				IS_WRITABLE (anon_page->type));
+		return false;
+	}
 
 	// 한 페이지의 sector의 개수만큼 sector에 write
 	for (int i = 0 ; i < SECTORS_PER_PAGE ; i ++)
 	{
 		lock_acquire(&swap_lock);
-		disk_write(swap_disk, page_no * SECTORS_PER_PAGE + i , page->va + DISK_SECTOR_SIZE * i );
+		disk_write(swap_disk, page_no * SECTORS_PER_PAGE + i , page->frame->kva + DISK_SECTOR_SIZE * i );
 		lock_release(&swap_lock);
 	}
 
-	// swap_map 셋팅
-	bitmap_set(swap_map, page_no, true);
-
-	//clear page
-	pml4_clear_page(thread_current()->pml4,page->va);
-
 	anon_page->swap_idx = page_no;
 	// printf("[END] anon_swap_out {%p}\n",page->va);
 	return true;
@@ -103,4 +279,30 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	struct frame *frame;
+	if (IS_SHARED (anon_page->type))
+		vm_text_release (page);
+	// 0 frame은 모두가 쓰므로 pml4_destroy()가 해제하지 않게 매핑을 지움
+	else if (anon_page->zero && thread_current ()->pml4 != NULL)
+		pml4_clear_page (thread_current ()->pml4, page->va);
+	// 메모리에 있는 페이지는 frame을 목록에서 빼고, frame의 kva는 pml4_destroy()가 해제
+	// 내보내는 중이면 끝날 때까지 기다리고, 그 frame은 내보낸 쪽이 해제
+	else if (thread_current ()->pml4 != NULL
+			&& (frame = vm_frame_claim (page)) != NULL) {
+		if (pml4_get_page (thread_current ()->pml4, page->va) == NULL)
+			palloc_free_page (frame->kva);
+		kmem_cache_free (frame_slab, frame);
+		page->frame = NULL;
+	}
+	if (anon_page->zswap_idx != -1)
+		vm_zswap_free (anon_page->zswap_idx);
+	// 디스크에 남은 slot은 돌려주고 미리 읽어 둔 내용도 버림
+	if (anon_page->swap_idx != -1) {
+		lock_acquire (&swap_lock);
+		int e = swap_cache_find (anon_page->swap_idx);
+		if (e != -1)
+			swap_cache_slot[e] = -1;
+		bitmap_reset (swap_map, anon_page->swap_idx);
+		lock_release (&swap_lock);
+	}
 }
@@ -3,6 +3,8 @@
 #include "vm/vm.h"
 #include "threads/pte.h"
 #include "threads/vaddr.h"
+#include "threads/mmu.h"
+#include <round.h>
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
@@ -65,17 +67,23 @@ file_backed_swap_out (struct page *page) {
 	// printf("[START] file_backed_swap_out %p\n",page->va);
 	struct file_page *file_page UNUSED = &page->file;
 	void *addr = page->va;
-	struct thread *t = thread_current();
+	// 다른 프로세스의 frame을 내보낼 수도 있으므로 frame 주인의 페이지 테이블을 씀
+	uint64_t *pml4 = page->frame->owner->pml4;
 
-	if(IS_WRITABLE(page->file.type))
-	{	
-		struct file *file = page->file.file;
-		int length = page->file.length;
+	// 2 MB 매핑을 나누지 못하면 매핑은 그대로 두고 실패
+	if (!pml4_split_page (pml4, addr))
+		return false;
+	// 주인이 계속 실행 중일 수 있으므로 매핑(TLB 포함)을 먼저 지운 뒤
+	// dirty bit를 읽고 씀, 그 뒤로는 아무도 이 frame에 쓰지 못함
+	pml4_clear_page(pml4,addr);
 
-		file_write_at (file,page->frame->kva,length,page->file.offset);
+	// 수정된 페이지만 파일에 씀, 깨끗한 페이지는 그냥 버림
+	if(IS_WRITABLE(page->file.type) && pml4_is_dirty(pml4,addr))
+	{	
+		file_write_at (page->file.file,page->frame->kva,page->file.bytes,
+				page->file.offset);
+		pml4_set_dirty(pml4,addr,false);
 	}
-	list_remove(&page->frame->elem);
-	pml4_clear_page(t->pml4,addr);
 	
 	page->frame->page = NULL;
 	page->frame = NULL;
@@ -87,8 +95,14 @@ file_backed_swap_out (struct page *page) {
 static void
 file_backed_destroy (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
-	if (page->frame) {
-		file_backed_swap_out(page);
+	// 내보내는 중이면 끝날 때까지 기다리고, 그 frame은 내보낸 쪽이 해제
+	struct frame *frame = vm_frame_claim (page);
+	if (frame != NULL) {
+		// 매핑을 지우지 못했으면 kva는 pml4_destroy()가 해제
+		if (file_backed_swap_out(page))
+			palloc_free_page (frame->kva);
+		kmem_cache_free (frame_slab, frame);
+		page->frame = NULL;
 	}
 }
 
@@ -101,18 +115,20 @@ do_mmap (void *addr, size_t length, int writable,
 		return NULL;
 	}
 
-	// 이미 할당된 페이지 인지 확인 
-	if(spt_find_page(&thread_current()->spt, addr))
-	{	
-		return NULL;
-	}
-
 	size_t file_size = file_length(file);
 	size_t read_bytes, zero_bytes;
 
 	read_bytes = length > file_size - offset ? length : file_size - offset;
 	zero_bytes = (ROUND_UP (read_bytes, PGSIZE)
 								- read_bytes);
+
+	// 매핑할 범위 전체가 비어 있는지 확인하고 SPT 공간을 미리 확보
+	size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+	if(!spt_range_empty(&thread_current()->spt, addr, page_cnt)
+			|| !spt_reserve_range(&thread_current()->spt, addr, page_cnt))
+	{	
+		return NULL;
+	}
 	enum vm_type type = writable ? (VM_FILE | IS_WRITABLE) : VM_FILE;
 	void *ret = addr;
 	while ( read_bytes > 0 || zero_bytes > 0 ) {
@@ -124,7 +140,7 @@ do_mmap (void *addr, size_t length, int writable,
 		file_read_bytes = file_size > PGSIZE ? PGSIZE : file_size;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 		// printf("file_read_bytes : %d\n",file_read_bytes);
-		struct file_info *file_info = calloc(sizeof(struct file_info),1);
+		struct file_info *file_info = kmem_cache_alloc (file_info_slab);
 		file_info->file = file;
 		file_info->offset = offset;
 		file_info->length = length;
@@ -134,7 +150,7 @@ do_mmap (void *addr, size_t length, int writable,
 					writable, lazy_load_segment,file_info))
 		{
 			printf("[FAIL] do_mmap.vm_alloc_page_with_initializer\n");
-			free(file_info);
+			kmem_cache_free (file_info_slab, file_info);
 			return NULL;
 		}
 		offset += page_read_bytes;
@@ -147,6 +163,50 @@ do_mmap (void *addr, size_t length, int writable,
 	return ret;
 }
 
+/* Adds PAGE to the write-back run WB if it is a resident, writable, dirty
+ * file page.  A page that does not continue the run in both address and file
+ * offset first flushes it.  Has the signature of an SPT action, so that a
+ * whole table can be written back in address order. */
+void
+file_writeback_add (void *page_, void *wb_) {
+	struct page *page = page_;
+	struct file_writeback *wb = wb_;
+	struct thread *t = thread_current ();
+
+	if (VM_TYPE (page->operations->type) != VM_FILE
+			|| !IS_WRITABLE (page->file.type) || page->frame == NULL
+			|| !pml4_is_dirty (t->pml4, page->va))
+		return;
+
+	if (wb->file != page->file.file || wb->bytes % PGSIZE != 0
+			|| (uint8_t *) page->va != wb->va + wb->bytes
+			|| page->file.offset != wb->offset + (off_t) wb->bytes)
+		file_writeback_flush (wb);
+	if (wb->file == NULL) {
+		wb->file = page->file.file;
+		wb->va = page->va;
+		wb->offset = page->file.offset;
+	}
+	wb->bytes += page->file.bytes;
+	wb->page_cnt++;
+}
+
+/* Writes the run collected in WB with one file_write_at() from the pages'
+ * user addresses, marks its pages clean and empties WB. */
+void
+file_writeback_flush (struct file_writeback *wb) {
+	struct thread *t = thread_current ();
+
+	if (wb->file == NULL)
+		return;
+	file_write_at (wb->file, wb->va, wb->bytes, wb->offset);
+	for (size_t i = 0; i < wb->page_cnt; i++)
+		pml4_set_dirty (t->pml4, wb->va + i * PGSIZE, false);
+	wb->file = NULL;
+	wb->bytes = 0;
+	wb->page_cnt = 0;
+}
+
 /* Do the munmap */
 void
 do_munmap (void *addr) {
@@ -155,21 +215,97 @@ do_munmap (void *addr) {
 	struct page *page = spt_find_page(&t->spt,addr);
 	struct file *file = page->file.file;
 	int length = page->file.length;
-
-	if(IS_WRITABLE(page->file.type))
-	{	
-		// printf("write before\n");
-		file_write_at (file,page->frame->kva,length,page->file.offset);
-	}	
-	
 	int page_cnt = ( length -1 ) / PGSIZE +1;
-	for (int i = 0 ; i < page_cnt ; i ++ ){
-		page = spt_find_page(&t->spt,addr+(PGSIZE * i));
-		if (page == NULL){
-			break;
-		}
-		spt_remove_page(&t->spt,page);
+
+	// 2MB 매핑은 지우기 전에 전부 4kB로 쪼개 둠
+	// 하나라도 못 쪼개면 아무것도 지우지 않고 매핑을 그대로 둠
+	for (int i = 0; i < page_cnt; i++)
+		if (!pml4_split_page (t->pml4, addr + i * PGSIZE))
+			return;
+
+	// 이어진 dirty 페이지들을 모아서 한 번에 씀
+	struct file_writeback wb = { .file = NULL };
+	for (int i = 0; i < page_cnt; i++) {
+		struct page *p = spt_find_page (&t->spt, addr + i * PGSIZE);
+		if (p != NULL)
+			file_writeback_add (p, &wb);
 	}
+	file_writeback_flush (&wb);
+
+	spt_remove_range(&t->spt,addr,page_cnt);
 	file_close(file);
 	// printf("[END]do_munmap end\n");
 }
+
+/* Returns true if every page of the LENGTH bytes at ADDR is in the current
+ * process's SPT. */
+static bool
+range_mapped (void *addr, size_t length) {
+	struct thread *t = thread_current ();
+
+	if (addr == NULL || pg_ofs (addr) != 0 || length == 0
+			|| !is_user_vaddr (addr) || !is_user_vaddr (addr + length - 1)
+			|| (uint8_t *) addr + length < (uint8_t *) addr)
+		return false;
+	for (size_t ofs = 0; ofs < length; ofs += PGSIZE)
+		if (spt_find_page (&t->spt, addr + ofs) == NULL)
+			return false;
+	return true;
+}
+
+/* Do the msync.  Writes back the dirty file pages among the LENGTH bytes at
+ * ADDR, coalescing contiguous ones.  There is no write-behind, so MS_ASYNC
+ * writes them now as well.  Returns 0 on success, -1 on failure. */
+int
+do_msync (void *addr, size_t length, int flags) {
+	struct thread *t = thread_current ();
+	struct file_writeback wb = { .file = NULL };
+
+	if ((flags != MS_SYNC && flags != MS_ASYNC) || !range_mapped (addr, length))
+		return -1;
+	for (size_t ofs = 0; ofs < length; ofs += PGSIZE)
+		file_writeback_add (spt_find_page (&t->spt, addr + ofs), &wb);
+	file_writeback_flush (&wb);
+	return 0;
+}
+
+/* Do the madvise.  RANDOM and SEQUENTIAL are remembered per page and set the
+ * read-ahead on faults; WILLNEED reads the range's file pages in now and
+ * DONTNEED gives its frames back now, writing dirty file pages back and
+ * sending anonymous pages to swap.  Returns 0 on success, -1 on failure. */
+int
+do_madvise (void *addr, size_t length, int advice) {
+	struct thread *t = thread_current ();
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+	if (!range_mapped (addr, length))
+		return -1;
+
+	switch (advice) {
+		case MADV_NORMAL:
+		case MADV_RANDOM:
+		case MADV_SEQUENTIAL:
+			for (size_t i = 0; i < page_cnt; i++)
+				spt_find_page (&t->spt, addr + i * PGSIZE)->advice = advice;
+			return 0;
+		case MADV_WILLNEED:
+			vm_prefetch (addr, page_cnt);
+			return 0;
+		case MADV_DONTNEED:
+			for (size_t i = 0; i < page_cnt; i++) {
+				struct page *page = spt_find_page (&t->spt, addr + i * PGSIZE);
+				enum vm_type type = VM_TYPE (page->operations->type);
+
+				// 공유 text frame과 0 frame은 다른 프로세스도 쓰므로 건드리지 않음
+				if (type == VM_UNINIT
+						|| (type == VM_ANON && (IS_SHARED (page->anon.type)
+								|| page->anon.zero))
+						|| pml4_get_page (t->pml4, page->va) == NULL)
+					continue;
+				vm_reclaim_page (page);
+			}
+			return 0;
+		default:
+			return -1;
+	}
+}
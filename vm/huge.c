@@ -0,0 +1,105 @@
+/* huge.c: 2 MB mappings for large aligned regions.
+ *
+ * When a fault hits an uninitialized anonymous or file-backed page and the
+ * whole 2 MB aligned chunk around it is in the supplemental page table, with
+ * every page still uninitialized, of the same type and equally writable, the
+ * chunk is claimed at once: 512 physically contiguous frames are mapped by a
+ * single page directory entry, so that the chunk needs one TLB entry instead
+ * of 512 and later faults in it never happen.
+ *
+ * Each page still has its own struct page and struct frame, so eviction,
+ * munmap and process exit keep working page by page.  Clearing one page's
+ * mapping splits the 2 MB entry back into 4 kB PTEs (see pml4_clear_page()),
+ * and the other 511 pages stay mapped. */
+
+#include "vm/huge.h"
+#include "threads/mmu.h"
+
+/* Returns true if the chunk starting at BASE can be mapped as one 2 MB page
+ * for a fault on PAGE. */
+static bool
+chunk_eligible (struct supplemental_page_table *spt, uint8_t *base,
+		struct page *page) {
+	enum vm_type type = page->uninit.type;
+	size_t i;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| IS_SHARED (type) || IS_STACK (type)
+			|| !is_user_vaddr (base + HPGSIZE - 1))
+		return false;
+
+	/* Most faults are in small regions; the chunk ends rule those out
+	 * before the full scan. */
+	if (spt_find_page (spt, base) == NULL
+			|| spt_find_page (spt, base + HPGSIZE - PGSIZE) == NULL)
+		return false;
+
+	for (i = 0; i < HPG_PAGES; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		if (p == NULL || VM_TYPE (p->operations->type) != VM_UNINIT
+				|| VM_TYPE (p->uninit.type) != VM_TYPE (type)
+				|| IS_WRITABLE (p->uninit.type) != IS_WRITABLE (type)
+				|| IS_SHARED (p->uninit.type))
+			return false;
+	}
+	return true;
+}
+
+/* Tries to claim PAGE together with the rest of its 2 MB chunk.  Returns
+ * false without changing anything if the chunk does not qualify or no huge
+ * frame is available, in which case the caller claims PAGE alone.
+ * Otherwise returns true and sets *SUCCESS to whether every page of the
+ * chunk was loaded. */
+bool
+vm_huge_claim (struct page *page, bool *success) {
+	struct thread *t = thread_current ();
+	struct supplemental_page_table *spt = &t->spt;
+	uint8_t *base = hpg_round_down (page->va);
+	uint8_t *kva;
+	size_t i;
+
+	if ((t->rss_limit != 0 && t->rss + HPG_PAGES > t->rss_limit)
+			|| !chunk_eligible (spt, base, page))
+		return false;
+	kva = palloc_get_huge_page (PAL_USER | PAL_ZERO);
+	if (kva == NULL)
+		return false;
+
+	for (i = 0; i < HPG_PAGES; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = kmem_cache_alloc (frame_slab);
+
+		if (frame == NULL)
+			goto fail;
+		frame->kva = kva + i * PGSIZE;
+		frame->text = NULL;
+		frame->page = p;
+		p->frame = frame;
+	}
+	if (!pml4_set_huge_page (t->pml4, base, kva,
+				IS_WRITABLE (page->uninit.type)))
+		goto fail;
+
+	*success = true;
+	for (i = 0; i < HPG_PAGES; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		if (!swap_in (p, p->frame->kva))
+			*success = false;
+	}
+	// 512개를 모두 읽은 뒤에야 eviction 대상이 됨
+	for (i = 0; i < HPG_PAGES; i++)
+		vm_frame_track (spt_find_page (spt, base + i * PGSIZE)->frame);
+	return true;
+
+fail:
+	while (i-- > 0) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		kmem_cache_free (frame_slab, p->frame);
+		p->frame = NULL;
+	}
+	palloc_free_multiple (kva, HPG_PAGES);
+	return false;
+}
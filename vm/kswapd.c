@@ -0,0 +1,77 @@
+/* kswapd.c: Background reclaim of user frames.
+ *
+ * Without it, a frame is evicted only when palloc has none left, by the
+ * faulting thread, which then waits for the swap-out.  The kswapd thread
+ * instead keeps a reserve of free user pages: vm_get_frame() pokes it on
+ * every allocation, and once the free pages drop below the low watermark
+ * it evicts frames, chosen by the usual clock, until they are back above
+ * the high watermark.  Page tables of exited processes still waiting for
+ * the reaper are freed first, since that costs no eviction.  A faulting
+ * thread still evicts by itself if the reserve runs out anyway. */
+
+#include "vm/kswapd.h"
+#include <stdbool.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Watermarks, as fractions of the user pool, with lower bounds for small
+ * pools. */
+#define KSWAPD_LOW_DIV 32
+#define KSWAPD_HIGH_DIV 16
+#define KSWAPD_LOW_MIN 8
+#define KSWAPD_HIGH_MIN 16
+
+static size_t low_pages, high_pages;
+static struct semaphore kswapd_sema;
+static bool kswapd_wanted;              /* Wakeup already requested. */
+static bool kswapd_ready;
+
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&kswapd_sema);
+		pml4_reap ();
+		while (palloc_user_free_cnt () < high_pages)
+			if (!vm_reclaim_frame ())
+				break;
+		kswapd_wanted = false;
+	}
+}
+
+/* Sets the watermarks and starts the kswapd thread.  Must be called after
+ * thread_start(). */
+void
+vm_kswapd_init (void) {
+	size_t user_pages = palloc_user_page_cnt ();
+
+	low_pages = user_pages / KSWAPD_LOW_DIV;
+	if (low_pages < KSWAPD_LOW_MIN)
+		low_pages = KSWAPD_LOW_MIN;
+	high_pages = user_pages / KSWAPD_HIGH_DIV;
+	if (high_pages < KSWAPD_HIGH_MIN)
+		high_pages = KSWAPD_HIGH_MIN;
+
+	sema_init (&kswapd_sema, 0);
+	kswapd_ready = true;
+	thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+}
+
+/* Wakes kswapd if free user pages are below the low watermark. */
+void
+vm_kswapd_poke (void) {
+	enum intr_level old_level;
+	bool wake;
+
+	if (!kswapd_ready || palloc_user_free_cnt () >= low_pages)
+		return;
+	old_level = intr_disable ();
+	wake = !kswapd_wanted;
+	kswapd_wanted = true;
+	intr_set_level (old_level);
+	if (wake)
+		sema_up (&kswapd_sema);
+}
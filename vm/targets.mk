@@ -3,3 +3,7 @@ vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
 vm_SRC += vm/inspect.c    # Testing utility
+vm_SRC += vm/text.c       # Shared executable text
+vm_SRC += vm/huge.c       # 2 MB mappings
+vm_SRC += vm/zswap.c      # Compressed swap cache
+vm_SRC += vm/kswapd.c     # Background reclaim
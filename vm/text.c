@@ -0,0 +1,175 @@
+/* text.c: Cache of read-only executable pages shared between processes.
+ *
+ * A read-only PT_LOAD page is identified by the inode of the executable, the
+ * file offset it starts at and the number of bytes read from the file.  The
+ * first process that faults such a page in reads it into a fresh frame and
+ * publishes the frame here; every later process that runs the same binary
+ * maps that frame instead of reading its own copy.  Shared frames are taken
+ * off the eviction list and are freed when the last page mapping them goes
+ * away. */
+
+#include "vm/text.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+
+struct text_entry {
+	struct hash_elem elem;
+	struct inode *inode;    /* Executable, reopened while cached. */
+	off_t ofs;              /* File offset of the page contents. */
+	size_t bytes;           /* Bytes read from the file, rest is zero. */
+	struct frame *frame;    /* Shared frame. */
+	int ref_cnt;            /* Number of pages mapping FRAME. */
+};
+
+static struct hash text_cache;
+/* Guards TEXT_CACHE and the reference counts.  vm_text_claim() holds it
+ * across vm_get_frame() and the read of the page, so that two processes
+ * faulting on the same page never load it twice.  Lock order:
+ * filesys_lock, when a system call faults on its buffer, then text_lock,
+ * then evict_lock and swap_lock inside vm_get_frame().  Nothing taken
+ * under text_lock comes back to it: eviction skips shared frames, and the
+ * read takes no VM lock. */
+static struct lock text_lock;
+
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct text_entry *t = hash_entry (e, struct text_entry, elem);
+	return hash_bytes (&t->inode, sizeof t->inode)
+		^ hash_int (t->ofs) ^ hash_int (t->bytes);
+}
+
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct text_entry *a = hash_entry (a_, struct text_entry, elem);
+	const struct text_entry *b = hash_entry (b_, struct text_entry, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->bytes < b->bytes;
+}
+
+void
+vm_text_init (void) {
+	hash_init (&text_cache, text_hash, text_less, NULL);
+	lock_init (&text_lock);
+}
+
+/* Claims the uninitialized read-only PAGE, mapping the shared frame for its
+ * contents if some process already loaded it and loading it otherwise. */
+bool
+vm_text_claim (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+	struct file_info *info = uninit->aux;
+	struct thread *t = thread_current ();
+	struct text_entry key, *e;
+	struct hash_elem *found;
+	bool success;
+
+	key.inode = file_get_inode (info->file);
+	key.ofs = info->offset;
+	key.bytes = info->bytes;
+
+	lock_acquire (&text_lock);
+	found = hash_find (&text_cache, &key.elem);
+	if (found != NULL) {
+		// 이미 올라와 있는 frame을 그대로 매핑
+		e = hash_entry (found, struct text_entry, elem);
+		page->frame = e->frame;
+		success = pml4_set_page (t->pml4, page->va, e->frame->kva, false)
+			&& uninit->page_initializer (page, uninit->type, e->frame->kva);
+		if (success)
+			e->ref_cnt++;
+		else
+			page->frame = NULL;
+		lock_release (&text_lock);
+		return success;
+	}
+
+	e = malloc (sizeof *e);
+	if (e == NULL) {
+		lock_release (&text_lock);
+		return false;
+	}
+	*e = key;
+	e->frame = vm_get_frame ();
+	if (e->frame == NULL) {
+		free (e);
+		lock_release (&text_lock);
+		return false;
+	}
+	e->frame->text = e;
+	e->ref_cnt = 1;
+	// 공유 frame은 eviction 대상에 넣지 않음
+	e->frame->page = page;
+	page->frame = e->frame;
+
+	success = pml4_set_page (t->pml4, page->va, e->frame->kva, false)
+		&& swap_in (page, e->frame->kva);
+	if (success) {
+		e->inode = inode_reopen (e->inode);
+		hash_insert (&text_cache, &e->elem);
+	} else {
+		pml4_clear_page (t->pml4, page->va);
+		palloc_free_page (e->frame->kva);
+		kmem_cache_free (frame_slab, e->frame);
+		free (e);
+		page->frame = NULL;
+	}
+	lock_release (&text_lock);
+	return success;
+}
+
+/* Gives the current process a page at the same address as SRC that maps the
+ * same shared frame.  Used by fork instead of copying the contents. */
+bool
+vm_text_fork (struct page *src) {
+	struct thread *t = thread_current ();
+	struct text_entry *e = src->frame->text;
+	struct page *page;
+
+	if (!vm_alloc_page (src->anon.type, src->va, false))
+		return false;
+	page = spt_find_page (&t->spt, src->va);
+
+	lock_acquire (&text_lock);
+	page->frame = e->frame;
+	anon_initializer (page, src->anon.type, e->frame->kva);
+	if (!pml4_set_page (t->pml4, page->va, e->frame->kva, false)) {
+		page->frame = NULL;
+		lock_release (&text_lock);
+		return false;
+	}
+	e->ref_cnt++;
+	lock_release (&text_lock);
+	return true;
+}
+
+/* Drops PAGE's reference to its shared frame.  The mapping is removed first
+ * so that pml4_destroy() does not free a frame other processes still use. */
+void
+vm_text_release (struct page *page) {
+	struct thread *t = thread_current ();
+	struct text_entry *e;
+
+	if (page->frame == NULL)
+		return;
+	e = page->frame->text;
+	if (t->pml4 != NULL)
+		pml4_clear_page (t->pml4, page->va);
+	page->frame = NULL;
+
+	lock_acquire (&text_lock);
+	if (--e->ref_cnt == 0) {
+		hash_delete (&text_cache, &e->elem);
+		inode_close (e->inode);
+		palloc_free_page (e->frame->kva);
+		kmem_cache_free (frame_slab, e->frame);
+		free (e);
+	}
+	lock_release (&text_lock);
+}
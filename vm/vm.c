@@ -1,28 +1,54 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/text.h"
+#include "vm/huge.h"
+#include "vm/kswapd.h"
 #include "include/threads/vaddr.h"
 #include "threads/mmu.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
 
-#define STACK_LIMIT 	(USER_STACK - (1 <<20))
+/* Default stack limit of a new process, in pages (1 MB), and the largest
+ * limit a process may set (1 GB). */
+#define STACK_DEFAULT_PAGES 256
+#define STACK_MAX_PAGES (1 << 18)
+/* Pages below a faulting stack address that get frames along with it. */
+#define STACK_AHEAD_PAGES 3
+/* Pages read ahead after a fault on a page loaded from a file, normally and
+ * in a range advised MADV_SEQUENTIAL. */
+#define FAULT_AROUND_PAGES 15
+#define FAULT_AROUND_SEQ_PAGES 63
+/* Ticks between working set samples of a process. */
+#define WSS_INTERVAL 100
 struct list frame_list;
+size_t vm_rss_limit;
+size_t vm_stack_limit = STACK_DEFAULT_PAGES;
+struct kmem_cache *page_slab;
+struct kmem_cache *frame_slab;
+struct kmem_cache *file_info_slab;
+/* Frame of zeros that every anonymous page nobody has written to yet maps
+ * read-only. */
+static void *zero_kva;
+/* Serializes picking victims with claiming frames, and signals the end of
+ * each eviction to threads waiting to free the evicted page or exit. */
+static struct lock evict_lock;
+static struct condition evict_done;
+
+static void spt_apply (struct supplemental_page_table *spt,
+		void (*action) (void *, void *), void *aux);
+void kill_func (void *value, void *aux);
+
+/* file_info는 load_segment와 mmap이 쓰는 필드가 달라서 0으로 시작 */
+static void
+file_info_ctor (void *obj) {
+	memset (obj, 0, sizeof (struct file_info));
+}
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
-void hash_print_func (struct hash_elem *e, void *aux){
-	struct page *p = hash_entry(e,struct page,hash_elem);
-	
-	printf("-------------------------------------------------------------\n");
-	printf("  %12p  |  %12p  |         |  \n",p->va,p->frame);
-}
-void 
-print_spt(){ 
-	printf("       VA       |       KV       |        FILE      | writable \n");
-	hash_apply(&thread_current()->spt,hash_print_func);
-	printf("=============================================================\n");
-}
-
 void
 vm_init (void) {
 	vm_anon_init ();
@@ -34,6 +60,16 @@ vm_init (void) {
 	list_init(&frame_list);
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	page_slab = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_slab = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	file_info_slab = kmem_cache_create ("file_info", sizeof (struct file_info),
+			file_info_ctor);
+	vm_text_init ();
+	lock_init (&evict_lock);
+	cond_init (&evict_done);
+	zero_kva = palloc_get_page (PAL_ZERO);
+	ASSERT (zero_kva != NULL);
+	vm_kswapd_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -54,6 +90,7 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static bool vm_zero_claim (struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -64,7 +101,7 @@ bool
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
-	struct hash *spt = &thread_current ()->spt; 
+	struct supplemental_page_table *spt = &thread_current ()->spt; 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
 		/* TODO: Create the page, fetch the initialier according to the VM type,
@@ -74,7 +111,9 @@ bool
 		/* TODO: Insert the page into the spt. */
 
 		// 1.가상 메모리 유형에 따라 uninit 페이지 초기화 
-		struct page *new_page = calloc(sizeof(struct page),1); 
+		struct page *new_page = kmem_cache_alloc (page_slab);
+		if (new_page == NULL)
+			goto err;
 		switch (VM_TYPE(type))
 		{
 		case VM_ANON:
@@ -101,98 +140,365 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct hash *spt UNUSED, void *va UNUSED) {
-	struct page page;
-	struct hash_elem *e;
-	page.va = pg_round_down(va);
-	e = hash_find(spt,&page.hash_elem);
-	if (e == NULL)
-		return NULL;
-	return hash_entry(e,struct page, hash_elem);
+spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
+	// 페이지 번호를 key로 바로 찾음
+#ifdef SPT_HASH
+	return ohash_find(&spt->pages,pg_no(va));
+#else
+	return radix_find(&spt->pages,pg_no(va));
+#endif
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct hash *spt UNUSED,
+spt_insert_page (struct supplemental_page_table *spt UNUSED,
 		struct page *page UNUSED) {
-	int succ = false;
-	hash_insert(spt,&page->hash_elem);
-	succ= true;
-	return succ;
+#ifdef SPT_HASH
+	return ohash_insert(&spt->pages,pg_no(page->va),page);
+#else
+	return radix_insert(&spt->pages,pg_no(page->va),page);
+#endif
 }
 
 void
-spt_remove_page (struct hash *spt, struct page *page) {
-	hash_delete(spt,&page->hash_elem);
+spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+#ifdef SPT_HASH
+	ohash_delete(&spt->pages,pg_no(page->va));
+#else
+	radix_delete(&spt->pages,pg_no(page->va));
+#endif
 	vm_dealloc_page (page);
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	
-	struct thread *t = thread_current();
+/* Returns true if no page of PAGE_CNT pages starting at VA is in SPT. */
+bool
+spt_range_empty (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt) {
+#ifdef SPT_HASH
+	for (size_t i = 0; i < page_cnt; i++)
+		if (ohash_find (&spt->pages, pg_no (va) + i) != NULL)
+			return false;
+	return true;
+#else
+	return radix_range_empty (&spt->pages, pg_no (va), page_cnt);
+#endif
+}
+
+/* Makes room in SPT for PAGE_CNT pages starting at VA, so that inserting
+ * them afterward cannot fail for lack of memory.  Returns false if the
+ * room could not be allocated. */
+bool
+spt_reserve_range (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt) {
+#ifdef SPT_HASH
+	return true;
+#else
+	return radix_reserve (&spt->pages, pg_no (va), page_cnt);
+#endif
+}
 
+/* Removes and frees every page of SPT among the PAGE_CNT pages starting
+ * at VA. */
+void
+spt_remove_range (struct supplemental_page_table *spt, void *va,
+		size_t page_cnt) {
+#ifdef SPT_HASH
+	for (size_t i = 0; i < page_cnt; i++) {
+		struct page *page = ohash_delete (&spt->pages, pg_no (va) + i);
+		if (page != NULL)
+			vm_dealloc_page (page);
+	}
+#else
+	radix_delete_range (&spt->pages, pg_no (va), page_cnt, kill_func);
+#endif
+}
+
+/* Calls ACTION on every page of SPT, in address order unless SPT_HASH is
+ * defined, with auxiliary data AUX. */
+static void
+spt_apply (struct supplemental_page_table *spt,
+		void (*action) (void *, void *), void *aux) {
+	spt->pages.aux = aux;
+#ifdef SPT_HASH
+	ohash_apply (&spt->pages, action);
+#else
+	radix_apply (&spt->pages, action);
+#endif
+}
+
+/* The frame lists and RSS counts are changed and walked with interrupts
+ * off, since eviction walks them from other threads, kswapd among them. */
+
+/* Puts FRAME on the eviction list and charges it to its owner. */
+static void
+vm_frame_link (struct frame *frame) {
+	enum intr_level old_level = intr_disable ();
+
+	list_push_back (&frame_list, &frame->elem);
+	list_push_back (&frame->owner->frames, &frame->owner_elem);
+	frame->owner->rss++;
+	intr_set_level (old_level);
+}
+
+/* Puts FRAME on the eviction list and charges it to the current process. */
+void
+vm_frame_track (struct frame *frame) {
+	frame->owner = thread_current ();
+	frame->evicting = false;
+	vm_frame_link (frame);
+}
+
+/* Takes FRAME off the eviction list and uncharges its owner. */
+void
+vm_frame_untrack (struct frame *frame) {
+	enum intr_level old_level = intr_disable ();
+
+	list_remove (&frame->elem);
+	list_remove (&frame->owner_elem);
+	frame->owner->rss--;
+	intr_set_level (old_level);
+}
+
+/* Takes every frame of T off the eviction list at once and frees their
+ * struct frames.  The pages lose their frames, but the frames stay mapped in
+ * T's page table, so that pml4_destroy() hands them back to palloc in bulk.
+ * Used at exit, after dirty file pages have been written back. */
+static void
+vm_frames_release (struct thread *t) {
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		struct frame *f = NULL;
+
+		if (!list_empty (&t->frames)) {
+			f = list_entry (list_pop_front (&t->frames), struct frame,
+					owner_elem);
+			list_remove (&f->elem);
+			t->rss--;
+			if (f->page != NULL)
+				f->page->frame = NULL;
+		}
+		intr_set_level (old_level);
+		if (f == NULL)
+			break;
+		kmem_cache_free (frame_slab, f);
+	}
+}
+
+/* Returns true if T holds as many frames as it may. */
+static bool
+vm_over_limit (struct thread *t) {
+	return t->rss_limit != 0 && t->rss >= t->rss_limit;
+}
+
+/* Every WSS_INTERVAL ticks, counts the frames of T accessed since the last
+ * sample as its working set and clears their accessed bits. */
+static void
+vm_sample_working_set (struct thread *t) {
+	int64_t now = timer_ticks ();
+	enum intr_level old_level;
 	struct list_elem *e;
+	size_t cnt = 0;
+
+	if (now - t->wss_tick < WSS_INTERVAL)
+		return;
+	t->wss_tick = now;
+	old_level = intr_disable ();
+	for (e = list_begin (&t->frames); e != list_end (&t->frames);
+			e = list_next (e)) {
+		struct frame *f = list_entry (e, struct frame, owner_elem);
 
-	for(e = list_begin(&frame_list) ; e != list_end(&frame_list); e = list_next(e)){
-		victim = list_entry(e,struct frame, elem);
-		// pte가 엑세스 된 경우
-		if(!pml4_is_accessed(t->pml4,victim->page->va)){
-			// 엑세스 되지 않은 pte는 바로 반환
-			list_remove(e);
-			return victim;
+		if (f->page != NULL && pml4_is_accessed (t->pml4, f->page->va)) {
+			pml4_set_accessed (t->pml4, f->page->va, false);
+			cnt++;
 		}
-		// printf("accessed va %p\n",victim->page->va);
 	}
-	
-	// 못 찾은 경우
-	for(e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e)){
-		victim = list_entry(e,struct frame, elem);
-		// pte가 엑세스 된 경우
-		// printf("victim->kva\n");
-		if(pml4_is_accessed(t->pml4,victim->page->va)){
-			// printf("22victim->kva\n");
-			break;
+	intr_set_level (old_level);
+	t->wss = cnt;
+}
+
+/* Returns the frame on E, an element of the global frame list if LOCAL is
+ * false or of a process's frames if it is true. */
+static struct frame *
+frame_of (struct list_elem *e, bool local) {
+	return local ? list_entry (e, struct frame, owner_elem)
+		: list_entry (e, struct frame, elem);
+}
+
+/* Picks a victim from LIST, linked as frame_of() says for LOCAL.  The first
+ * pass looks only at frames of processes holding more than their working
+ * set, the second gives accessed frames a second chance by clearing their
+ * bit, and the third takes any frame.  Pages not loaded yet are never
+ * taken.  Returns a null pointer if LIST has no frame in use. */
+static struct frame *
+clock_victim (struct list *list, bool local) {
+	struct list_elem *e;
+
+	for (int pass = 0; pass < 3; pass++)
+		for (e = list_begin (list); e != list_end (list); e = list_next (e)) {
+			struct frame *f = frame_of (e, local);
+			uint64_t *pml4 = f->owner->pml4;
+
+			if (f->page == NULL || f->owner->vm_exiting
+					|| VM_TYPE (f->page->operations->type) == VM_UNINIT
+					|| (pass == 0 && f->owner->rss <= f->owner->wss))
+				continue;
+			if (pass == 2 || !pml4_is_accessed (pml4, f->page->va))
+				return f;
+			if (pass == 1)
+				pml4_set_accessed (pml4, f->page->va, false);
 		}
+	return NULL;
+}
+
+/* Get the struct frame, that will be evicted.  The victim comes off the
+ * frame lists before interrupts are back on, so that kswapd and faulting
+ * threads never pick the same frame.  It is marked evicting and counted
+ * against its owner until vm_evict() is done with it. */
+static struct frame *
+vm_get_victim (void) {
+	struct thread *t = thread_current ();
+	struct frame *victim = NULL;
+	enum intr_level old_level;
+
+	lock_acquire (&evict_lock);
+	old_level = intr_disable ();
+	// 자기 몫을 다 쓴 프로세스는 다른 프로세스 대신 자기 frame을 내보냄
+	if (vm_over_limit (t))
+		victim = clock_victim (&t->frames, true);
+	if (victim == NULL)
+		victim = clock_victim (&frame_list, false);
+	if (victim != NULL) {
+		vm_frame_untrack (victim);
+		victim->evicting = true;
+		victim->owner->evict_cnt++;
 	}
-	// 엑세스 비트를 0으로 변경
-	pml4_set_accessed(t->pml4,victim->page->va,0);
-	
-	list_remove(e);
-	
+	intr_set_level (old_level);
+	lock_release (&evict_lock);
 	return victim;
 }
+
+/* Writes out the page in VICTIM, a frame from vm_get_victim(), and detaches
+ * the two.  The caller then owns VICTIM and its kva: neither the owner's
+ * destroy nor its exit frees them.  If the page cannot be written out,
+ * VICTIM goes back to its owner and false is returned. */
+static bool
+vm_evict (struct frame *victim) {
+	struct thread *owner = victim->owner;
+	struct page *page = victim->page;
+	bool success = swap_out (page);
+
+	lock_acquire (&evict_lock);
+	if (success) {
+		// 그 사이 주인이 다시 fault를 내서 새 frame을 받았으면 그대로 둠
+		if (page->frame == victim)
+			page->frame = NULL;
+		victim->page = NULL;
+	} else
+		vm_frame_link (victim);
+	victim->evicting = false;
+	owner->evict_cnt--;
+	cond_broadcast (&evict_done, &evict_lock);
+	lock_release (&evict_lock);
+	return success;
+}
   
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	swap_out(victim->page);
+	struct frame *victim = vm_get_victim ();
+
+	if (victim == NULL || !vm_evict (victim))
+		return NULL;
 	return victim;
 }
 
+/* Evicts one frame, picked from every process's frames, and gives it back
+ * to the page allocator.  Returns false if no frame can be evicted. */
+bool
+vm_reclaim_frame (void) {
+	struct frame *victim = vm_get_victim ();
+
+	if (victim == NULL || !vm_evict (victim))
+		return false;
+	palloc_free_page (victim->kva);
+	kmem_cache_free (frame_slab, victim);
+	return true;
+}
+
+/* Takes the frame holding PAGE off the frame lists for the caller to free,
+ * first waiting for any eviction of it to finish.  Returns a null pointer
+ * if PAGE is not resident, including when the eviction took its frame. */
+struct frame *
+vm_frame_claim (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire (&evict_lock);
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait (&evict_done, &evict_lock);
+	frame = page->frame;
+	if (frame != NULL)
+		vm_frame_untrack (frame);
+	lock_release (&evict_lock);
+	return frame;
+}
+
+/* Waits for an eviction of PAGE under way to finish.  Returns true if
+ * PAGE is still resident afterwards, because the eviction failed. */
+static bool
+vm_evict_wait (struct page *page) {
+	bool waited = false;
+	bool resident;
+
+	lock_acquire (&evict_lock);
+	while (page->frame != NULL && page->frame->evicting) {
+		cond_wait (&evict_done, &evict_lock);
+		waited = true;
+	}
+	resident = waited && page->frame != NULL;
+	lock_release (&evict_lock);
+	return resident;
+}
+
+/* Stops new evictions of T's frames and waits for those under way, so
+ * that T can tear down its pages and page table. */
+static void
+vm_evict_quiesce (struct thread *t) {
+	lock_acquire (&evict_lock);
+	t->vm_exiting = true;
+	while (t->evict_cnt > 0)
+		cond_wait (&evict_done, &evict_lock);
+	lock_release (&evict_lock);
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame *
+ * and return it. That is, if the user pool memory is full, this function
+ * evicts the frame to get the available memory space.  Returns a null
+ * pointer if there is no free page and no frame can be evicted.
+ * The frame is not on the eviction list yet: the caller calls
+ * vm_frame_track() once the page in it is loaded and mapped, so that
+ * nobody evicts a page that is still being read in. */
+struct frame *
 vm_get_frame (void) {
-	struct frame *frame = calloc(sizeof(struct frame),1); 
-	frame->kva = palloc_get_page(PAL_ZERO | PAL_USER);
+	struct frame *frame = kmem_cache_alloc (frame_slab);
+	if (frame == NULL)
+		return NULL;
+	// 몫을 다 쓴 프로세스는 빈 frame이 있어도 자기 frame을 내보내서 씀
+	frame->kva = vm_over_limit (thread_current ())
+		? NULL : palloc_get_page(PAL_ZERO | PAL_USER);
+	frame->text = NULL;
+	frame->evicting = false;
 	
+	// 남은 frame이 적으면 kswapd가 미리 비워 두도록 깨움
+	vm_kswapd_poke ();
 	if(frame->kva == NULL){
-		free(frame);
+		kmem_cache_free (frame_slab, frame);
 		frame = vm_evict_frame();
-		frame->page = NULL;
-		list_push_back(&frame_list,&frame->elem);
+		if (frame == NULL)
+			return NULL;
 		return frame;
 	}
-	// frame list에 맨 끝에 넣음
-	list_push_back(&frame_list,&frame->elem);
 
 	frame->page = NULL;
 	ASSERT (frame != NULL);
@@ -200,18 +506,285 @@ vm_get_frame (void) {
 	return frame;
 }
 
-/* Growing the stack. */
-static void
-vm_stack_growth (void *addr UNUSED) {
-	thread_current()->stack_bottom = addr;
-	vm_alloc_page(VM_ANON | IS_STACK |IS_WRITABLE, addr,true);
+/* Returns true if PAGE_CNT is a stack limit a process may set. */
+bool
+vm_stack_limit_valid (long page_cnt) {
+	return page_cnt > 0 && page_cnt <= STACK_MAX_PAGES;
+}
+
+/* Returns the lowest address the stack of T may grow down to. */
+static uint8_t *
+stack_floor (struct thread *t) {
+	return (uint8_t *) USER_STACK - t->stack_limit * PGSIZE;
+}
+
+/* Growing the stack.  One fault covers every missing page from ADDR up to
+ * the pages already on the stack, so a large frame or array costs a single
+ * fault.  Those pages map the zero frame and get frames of their own when
+ * written.  On a write, the page at ADDR and up to STACK_AHEAD_PAGES below
+ * it, within the stack limit, get frames right away, so a stack that keeps
+ * growing faults once every few pages instead of on every page. */
+static bool
+vm_stack_growth (void *addr, bool write) {
+	struct thread *t = thread_current ();
+	uint8_t *fault = pg_round_down (addr);
+	uint8_t *top = fault, *bottom = fault, *p;
 
-	vm_claim_page(addr);
+	while (top + PGSIZE < (uint8_t *) USER_STACK
+			&& spt_find_page (&t->spt, top + PGSIZE) == NULL)
+		top += PGSIZE;
+	if (write)
+		for (int i = 0; i < STACK_AHEAD_PAGES; i++) {
+			if (bottom - PGSIZE < stack_floor (t)
+					|| spt_find_page (&t->spt, bottom - PGSIZE) != NULL)
+				break;
+			bottom -= PGSIZE;
+		}
+
+	for (p = bottom; p <= top; p += PGSIZE) {
+		// 읽기만 했거나 쓴 곳보다 위라면 0 페이지를 매핑하고 frame은 처음 쓸 때 받음
+		bool claimed = vm_alloc_page (VM_ANON | IS_STACK | IS_WRITABLE, p, true)
+			&& (write && p <= fault ? vm_claim_page (p)
+					: vm_zero_claim (spt_find_page (&t->spt, p)));
+		if (!claimed)
+			return false;
+	}
+	if (bottom < (uint8_t *) t->stack_bottom)
+		t->stack_bottom = bottom;
+	return true;
+}
+
+/* Returns true if PAGE is an anonymous page, not yet claimed, that starts
+ * out all zeros: a zero-fill page, or a BSS page with nothing to read. */
+static bool
+is_zero_fill_page (struct page *page) {
+	struct file_info *info;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON
+			|| IS_SHARED (page->uninit.type))
+		return false;
+	if (page->uninit.init == NULL)
+		return true;
+	info = page->uninit.aux;
+	return page->uninit.init == lazy_load_segment && info->bytes == 0;
+}
+
+/* Turns PAGE, which is_zero_fill_page() accepts, into an anonymous page
+ * that maps the shared zero frame read-only.  A later write fault gives it
+ * a frame of its own in vm_handle_wp(). */
+static bool
+vm_zero_claim (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+
+	if (!pml4_set_page (thread_current ()->pml4, page->va, zero_kva, false))
+		return false;
+	uninit->page_initializer (page, uninit->type, NULL);
+	page->anon.zero = true;
+	return true;
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	struct thread *t = thread_current ();
+	struct frame *frame;
+	bool success;
+
+	if (VM_TYPE (page->operations->type) != VM_ANON || !page->anon.zero
+			|| !IS_WRITABLE (page->anon.type))
+		return false;
+
+	// 쫓아낸 frame을 받을 수도 있으므로 직접 0으로 채움
+	frame = vm_get_frame ();
+	if (frame == NULL)
+		return false;
+	memset (frame->kva, 0, PGSIZE);
+	frame->page = page;
+	page->frame = frame;
+	page->anon.zero = false;
+
+	// 0 frame을 가리키던 TLB 항목까지 지운 뒤 새 frame을 매핑
+	pml4_clear_page (t->pml4, page->va);
+	success = pml4_set_page (t->pml4, page->va, frame->kva, true);
+	vm_frame_track (frame);
+	return success;
+}
+
+/* Gives every page from VA through VA + SIZE - 1 that still maps the zero
+ * frame a frame of its own.  CR0.WP is set, so a kernel write to such a
+ * page faults and is unshared by vm_handle_wp() anyway; system calls that
+ * know their buffer call this first so that the faults are not taken
+ * while they hold filesys_lock or a pipe. */
+void
+vm_zero_unshare (const void *va, size_t size) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	const void *p;
+
+	if (size == 0)
+		return;
+	for (p = pg_round_down (va); p < va + size; p += PGSIZE) {
+		struct page *page = spt_find_page (spt, (void *) p);
+
+		if (page != NULL)
+			vm_handle_wp (page);
+	}
+}
+
+/* Returns true if PAGE is still waiting to be read from a file by
+ * lazy_load_segment() into a frame of its own. */
+static bool
+is_lazy_file_page (struct page *page) {
+	return page != NULL && VM_TYPE (page->operations->type) == VM_UNINIT
+		&& page->uninit.init == lazy_load_segment
+		&& !IS_SHARED (page->uninit.type);
+}
+
+/* Returns true if NEXT is an unloaded page whose file contents directly
+ * follow those of PREV, another such page, so that one read covers both. */
+static bool
+file_run_continues (struct page *prev, struct page *next) {
+	struct file_info *a = prev->uninit.aux;
+	struct file_info *b;
+
+	if (!is_lazy_file_page (next) || next->uninit.type != prev->uninit.type)
+		return false;
+	b = next->uninit.aux;
+	return b->file == a->file && a->bytes == PGSIZE
+		&& b->offset == a->offset + PGSIZE;
+}
+
+/* Returns how many pages, up to MAX, directly follow PAGE and continue its
+ * file contents.  Must be called before PAGE is claimed. */
+static size_t
+fault_around_count (struct page *page, size_t max) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *prev = page;
+	size_t cnt;
+
+	if (!is_lazy_file_page (page))
+		return 0;
+	for (cnt = 0; cnt < max; cnt++) {
+		struct page *next = spt_find_page (spt, prev->va + PGSIZE);
+
+		if (!file_run_continues (prev, next))
+			break;
+		prev = next;
+	}
+	return cnt;
+}
+
+/* Returns how many pages to read ahead after a fault on PAGE, following
+ * the madvise() hint for it. */
+static size_t
+fault_around_window (struct page *page) {
+	switch (page->advice) {
+		case MADV_RANDOM:
+			return 0;
+		case MADV_SEQUENTIAL:
+			return FAULT_AROUND_SEQ_PAGES;
+		default:
+			return FAULT_AROUND_PAGES;
+	}
+}
+
+/* Gives PAGE a free frame and maps it, writable if WRITABLE.  The page is
+ * only read ahead, so this never evicts.  As with vm_get_frame(), the
+ * caller tracks the frame once the page is loaded.  Returns false if there
+ * is no free frame or the page table cannot grow. */
+static bool
+vm_map_free_frame (struct page *page, bool writable) {
+	struct frame *frame;
+	void *kva;
+
+	if (vm_over_limit (thread_current ())
+			|| (kva = palloc_get_page (PAL_USER)) == NULL)
+		return false;
+	if ((frame = kmem_cache_alloc (frame_slab)) == NULL) {
+		palloc_free_page (kva);
+		return false;
+	}
+	if (!pml4_set_page (thread_current ()->pml4, page->va, kva, writable)) {
+		kmem_cache_free (frame_slab, frame);
+		palloc_free_page (kva);
+		return false;
+	}
+	frame->kva = kva;
+	frame->text = NULL;
+	frame->page = page;
+	page->frame = frame;
+	return true;
+}
+
+/* Maps as many of the CNT pages starting at FIRST, which continue each
+ * other's file contents, as there are free frames for, and loads them with
+ * one read.  Stops at the first page someone else already claimed.
+ * Returns the number of pages loaded. */
+static size_t
+fault_around_load (struct page *first, size_t cnt) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		struct page *page = spt_find_page (spt, first->va + i * PGSIZE);
+
+		if (!is_lazy_file_page (page)
+				|| !vm_map_free_frame (page, IS_WRITABLE (page->uninit.type)))
+			break;
+	}
+	if (i == 0)
+		return 0;
+	lazy_load_run (first, i);
+	// 한 번에 다 읽은 뒤에야 eviction 대상이 됨
+	for (size_t j = 0; j < i; j++)
+		vm_frame_track (spt_find_page (spt, first->va + j * PGSIZE)->frame);
+	return i;
+}
+
+/* Loads the pages of the PAGE_CNT pages from VA that come from a file and
+ * are not resident, as far as free frames last.  Runs of pages not yet
+ * loaded are read with one read each. */
+void
+vm_prefetch (void *va, size_t page_cnt) {
+	struct thread *t = thread_current ();
+	size_t i = 0;
+
+	while (i < page_cnt) {
+		struct page *page = spt_find_page (&t->spt, va + i * PGSIZE);
+		size_t n = 1;
+
+		if (page != NULL && pml4_get_page (t->pml4, page->va) == NULL) {
+			if (is_lazy_file_page (page)) {
+				n += fault_around_count (page, page_cnt - i - 1);
+				if (fault_around_load (page, n) < n)
+					break;
+			} else if (VM_TYPE (page->operations->type) == VM_FILE) {
+				if (!vm_map_free_frame (page, IS_WRITABLE (page->file.type)))
+					break;
+				swap_in (page, page->frame->kva);
+				vm_frame_track (page->frame);
+			}
+		}
+		i += n;
+	}
+}
+
+/* Evicts the resident PAGE right away and gives its frame back to the page
+ * allocator.  PAGE must not share its frame. */
+void
+vm_reclaim_page (struct page *page) {
+	struct frame *frame = vm_frame_claim (page);
+
+	if (frame == NULL)
+		return;
+	// 2 MB 매핑을 나누지 못하면 내보내지 않고 그대로 둠
+	if (!swap_out (page)) {
+		vm_frame_track (frame);
+		return;
+	}
+	page->frame = NULL;
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_slab, frame);
 }
 
 /* Return true on success */
@@ -219,8 +792,9 @@ bool
 vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
 	
-	struct hash *spt UNUSED = &thread_current ()->spt;
+	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
 	struct page *page = spt_find_page(spt,addr);
+	vm_sample_working_set (thread_current ());
 	// printf("[DBG] vm_try_handle_fault(): addr = %p, user = %d, write = %d, not_present = %d\n",
 	// 		addr, user, write, not_present); /////////////
 	if(addr == NULL)
@@ -230,11 +804,8 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	{
 		void *rsp = f->rsp;
 
-		if((uint64_t)addr > STACK_LIMIT && USER_STACK > (uint64_t)addr && rsp - 8 <= addr)
-		{
-			vm_stack_growth(thread_current()->stack_bottom - PGSIZE);
-			return true;
-		}
+		if((uint8_t *)addr >= stack_floor (thread_current ()) && USER_STACK > (uint64_t)addr && rsp - 8 <= addr)
+			return vm_stack_growth(addr, write);
 		// printf("stack_growth fail\n");
 		return false;
 	}
@@ -261,17 +832,33 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 			}
 			break;
 		case VM_FILE:
-			// print_spt();
 			if(IS_STACK(page->file.type)|| (!IS_WRITABLE(page->file.type)&& write))
 				return false;
 			break;
+		default:
+			break;
 	}
 	
 	
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 	// printf("[END] vm_try_handle_fault\n");
-	return vm_do_claim_page (page);
+	// 다른 스레드가 내보내려고 매핑을 지운 페이지면 끝날 때까지 기다림
+	if (not_present && vm_evict_wait (page))
+		return true;
+	// 이미 매핑된 페이지에 쓰다 난 fault는 0 frame을 쓰던 경우뿐
+	if (!not_present)
+		return write && vm_handle_wp (page);
+	// 0으로 시작하는 anon 페이지를 읽기만 하면 0 frame을 매핑
+	if (!write && is_zero_fill_page (page))
+		return vm_zero_claim (page);
+	// 파일에서 읽는 페이지면 이어지는 페이지들도 한 번에 읽어서 매핑
+	size_t cnt = fault_around_count (page, fault_around_window (page));
+	if (!vm_do_claim_page (page))
+		return false;
+	if (cnt > 0)
+		fault_around_load (spt_find_page (spt, page->va + PGSIZE), cnt);
+	return true;
 }
 
 /* Free the page.
@@ -279,7 +866,7 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	kmem_cache_free (page_slab, page);
 }
 
 /* Claim the page that allocate on VA. */
@@ -297,8 +884,18 @@ vm_claim_page (void *va UNUSED) {
 static bool
 vm_do_claim_page (struct page *page) {
 	// printf("[START]vm_do_claim_page\n");
+	// 읽기 전용 text 페이지는 다른 프로세스와 frame을 공유
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& IS_SHARED (page->uninit.type))
+		return vm_text_claim (page);
+	// 2MB로 정렬된 큰 영역은 한 번에 huge page로 매핑
+	bool success;
+	if (vm_huge_claim (page, &success))
+		return success;
 	struct frame *frame = vm_get_frame ();
 	struct thread *t = thread_current();
+	if (frame == NULL)
+		return false;
 	// printf("%p\n",page->va);
 	/* Set links */
 	frame->page = page;
@@ -312,30 +909,40 @@ vm_do_claim_page (struct page *page) {
 	// printf("pml4_get_page:%p\n",pml4_get_page(t->pml4,page->va));
 	// printf("kva : %p\n",page->frame->kva);
 	// printf("[END] vm_do_claim_page\n");
-	return swap_in (page, frame->kva);
+	// 다 읽은 뒤에야 eviction 대상이 됨
+	success = swap_in (page, frame->kva);
+	vm_frame_track (frame);
+	return success;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct hash *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	// printf("[START] supplemental_page_table_init \n");
 
-	if(!hash_init(spt,page_hash,spt_less_func,NULL))
-	{
-		printf("[FAIL] supplemental_page_table_init. hash init\n");
-	}
+#ifdef SPT_HASH
+	ohash_init(&spt->pages,NULL);
+#else
+	radix_init(&spt->pages,NULL);
+#endif
 	// printf("[END] supplemental_page_table_init \n");
 }
 bool lazy_fork_load(struct page *page, void *aux) {
 	struct page *src= (struct page*) aux;
-	memcpy(page->frame->kva,src->frame->kva,PGSIZE);
+	memcpy_page(page->frame->kva,src->frame->kva);
 	return true;
 }
 
-void hash_insert_new_func (struct hash_elem *e, void *aux){
+/* Passed by supplemental_page_table_copy() to hash_insert_new_func(). */
+struct spt_copy {
+	struct supplemental_page_table *dst;
+	bool success;
+};
+
+void hash_insert_new_func (void *value, void *aux){
 	// src -> dst 
-	struct hash* child_spt = (struct hash *)aux;
-	struct page* page = hash_entry(e,struct page, hash_elem);
+	struct spt_copy *copy = aux;
+	struct page* page = value;
 	switch (page->operations->type)
 	{
 	case VM_UNINIT:
@@ -343,6 +950,17 @@ void hash_insert_new_func (struct hash_elem *e, void *aux){
 		IS_WRITABLE(page->uninit.type),page->uninit.init,page->uninit.aux);
 		break;
 	case VM_ANON:
+		if (IS_SHARED(page->anon.type)) {
+			if (!vm_text_fork(page))
+				copy->success = false;
+			break;
+		}
+		// 아직 아무도 쓰지 않은 페이지는 자식도 0 frame을 매핑
+		if (page->anon.zero) {
+			vm_alloc_page(page->anon.type,page->va,IS_WRITABLE(page->anon.type));
+			vm_zero_claim(spt_find_page(&thread_current()->spt,page->va));
+			break;
+		}
 		vm_alloc_page_with_initializer(page->anon.type,page->va,
 		IS_WRITABLE(page->anon.type),lazy_fork_load, page);
 		vm_claim_page(page->va);
@@ -352,30 +970,44 @@ void hash_insert_new_func (struct hash_elem *e, void *aux){
 		IS_WRITABLE(page->file.type),lazy_fork_load, page);
 		vm_claim_page(page->va);
 		break;
+	default:
+		break;
 	}
 
 }
-void print (struct hash_elem *e, void *aux){
-	struct page* page = hash_entry(e,struct page, hash_elem);
-	// printf("page->va :%p page->type :%d \n",page->va,page->operations->type);
-}
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct hash *dst UNUSED,
-		struct hash *src UNUSED) {
-	hash_apply(src,print);
-	src->aux = dst;
-	hash_apply(src,hash_insert_new_func);
-	return true;
+supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
+		struct supplemental_page_table *src UNUSED) {
+	struct spt_copy copy = { .dst = dst, .success = true };
+
+	// 주소 순서대로 복사 (radix tree)
+	spt_apply(src,hash_insert_new_func,&copy);
+	return copy.success;
 }
-void kill_func (struct hash_elem *e, void *aux){
-	struct page *page = hash_entry(e,struct page, hash_elem);
+void kill_func (void *value, void *aux){
+	struct page *page = value;
 	vm_dealloc_page(page);
 }
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct hash *spt UNUSED) {
+supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	hash_clear(spt,kill_func);
+	struct thread *t = thread_current ();
+	// 다른 스레드가 내보내는 중인 frame이 끝날 때까지 기다린 뒤 정리
+	vm_evict_quiesce (t);
+	// mmap된 dirty 페이지를 주소 순서로 모아서 씀
+	struct file_writeback wb = { .file = NULL };
+	spt_apply (spt, file_writeback_add, &wb);
+	file_writeback_flush (&wb);
+	// frame은 한꺼번에 목록에서 빼고, 페이지별 destroy는 swap slot 등만 정리
+	vm_frames_release (t);
+#ifdef SPT_HASH
+	ohash_clear(&spt->pages,kill_func);
+#else
+	radix_clear(&spt->pages,kill_func);
+#endif
+	// exec 뒤에는 같은 스레드가 다시 frame을 가짐
+	t->vm_exiting = false;
 }
@@ -0,0 +1,111 @@
+/* zswap.c: Compressed in-memory cache in front of the swap disk.
+ *
+ * An evicted anonymous page is first compressed into a fixed pool of kernel
+ * memory, and goes to the swap disk only if it does not compress well or
+ * the pool has no room.  The pool is cut into ZSWAP_CHUNK-byte chunks; a
+ * page takes a run of chunks, found first fit in a bitmap, that starts with
+ * a 2-byte header holding its compressed size.  Swapping such a page back
+ * in is a decompression from memory instead of a PIO read of a whole page
+ * of sectors. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pages of kernel memory in the pool. */
+#define ZSWAP_POOL_PAGES 128
+/* Unit of allocation in the pool. */
+#define ZSWAP_CHUNK 64
+/* Pages that do not compress to this many bytes go to the disk. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+/* Size of the header in front of each compressed page. */
+#define ZSWAP_HDR sizeof (uint16_t)
+
+static uint8_t *pool;
+static struct bitmap *pool_map;     /* Chunks in use. */
+static uint8_t *scratch;            /* Compressor output. */
+static struct lock zswap_lock;
+
+/* Allocates the pool. */
+void
+vm_zswap_init (void) {
+	pool = palloc_get_multiple (0, ZSWAP_POOL_PAGES);
+	scratch = palloc_get_page (0);
+	pool_map = bitmap_create (ZSWAP_POOL_PAGES * PGSIZE / ZSWAP_CHUNK);
+	if (pool == NULL || scratch == NULL || pool_map == NULL)
+		PANIC ("out of memory for the compressed swap pool");
+	lock_init (&zswap_lock);
+}
+
+/* Returns the address of the entry whose first chunk is IDX. */
+static uint8_t *
+entry (int idx) {
+	return pool + (size_t) idx * ZSWAP_CHUNK;
+}
+
+/* Returns the compressed size of the entry at IDX. */
+static size_t
+entry_len (int idx) {
+	uint16_t len;
+
+	memcpy (&len, entry (idx), ZSWAP_HDR);
+	return len;
+}
+
+/* Returns the number of chunks an entry of LEN compressed bytes takes. */
+static size_t
+entry_chunks (size_t len) {
+	return DIV_ROUND_UP (ZSWAP_HDR + len, ZSWAP_CHUNK);
+}
+
+/* Compresses the page at KVA into the pool.  Returns the index of the
+ * entry, or -1 if the page does not compress well enough or the pool has
+ * no room, in which case the caller writes it to the swap disk. */
+int
+vm_zswap_store (const void *kva) {
+	size_t idx = BITMAP_ERROR;
+	size_t len;
+
+	lock_acquire (&zswap_lock);
+	len = lz_compress (kva, PGSIZE, scratch, ZSWAP_MAX_LEN);
+	if (len != 0)
+		idx = bitmap_scan_and_flip (pool_map, 0, entry_chunks (len), false);
+	if (idx != BITMAP_ERROR) {
+		uint16_t hdr = len;
+
+		memcpy (entry (idx), &hdr, ZSWAP_HDR);
+		memcpy (entry (idx) + ZSWAP_HDR, scratch, len);
+	}
+	lock_release (&zswap_lock);
+	return idx != BITMAP_ERROR ? (int) idx : -1;
+}
+
+/* Decompresses the entry at IDX into the page at KVA and frees the entry.
+ * Returns false if the entry is corrupt. */
+bool
+vm_zswap_load (int idx, void *kva) {
+	size_t len;
+	bool ok;
+
+	lock_acquire (&zswap_lock);
+	len = entry_len (idx);
+	ok = lz_decompress (entry (idx) + ZSWAP_HDR, len, kva, PGSIZE);
+	bitmap_set_multiple (pool_map, idx, entry_chunks (len), false);
+	lock_release (&zswap_lock);
+	return ok;
+}
+
+/* Frees the entry at IDX without reading it. */
+void
+vm_zswap_free (int idx) {
+	lock_acquire (&zswap_lock);
+	bitmap_set_multiple (pool_map, idx, entry_chunks (entry_len (idx)), false);
+	lock_release (&zswap_lock);
+}